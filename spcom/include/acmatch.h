@@ -0,0 +1,41 @@
+#ifndef ACMATCH_INCLUDE_H_
+#define ACMATCH_INCLUDE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * multi-pattern (keyword) matcher for streams. Aho-Corasick automaton
+ * compiled to a DFA, so cost per input byte is two table lookups regardless
+ * of the number of patterns. Bytes not in any pattern share one equivalence
+ * class to keep the transition table small. State kept between calls, i.e.
+ * matches can span chunks.
+ */
+struct acmatch;
+
+/// @param id index of pattern as returned by acmatch_add()
+typedef void (acmatch_cb)(int id, size_t end, void *arg);
+
+struct acmatch *acmatch_new(void);
+void acmatch_free(struct acmatch *ac);
+
+/**
+ * add pattern. must be called before acmatch_compile()
+ * @return pattern id (0, 1, ...) or negative errno
+ */
+int acmatch_add(struct acmatch *ac, const void *pattern, size_t len);
+
+/// @return zero or negative errno
+int acmatch_compile(struct acmatch *ac);
+
+/// length of pattern `id`
+size_t acmatch_pattern_len(const struct acmatch *ac, int id);
+
+/**
+ * feed data. `cb` called for each match.
+ * `end` is offset in data after last byte of match.
+ */
+void acmatch_feed(struct acmatch *ac, const void *data, size_t size,
+                  acmatch_cb *cb, void *arg);
+
+#endif
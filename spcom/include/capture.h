@@ -0,0 +1,39 @@
+#ifndef CAPTURE_INCLUDE_H_
+#define CAPTURE_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * capture file. full fidelity record of all data received and sent,
+ * regardless of display options. One record per line:
+ *
+ *     <epoch sec>.<usec> <tag> <data as hex | event text>
+ *
+ * tag is the direction, e.g. "RX" or "TX", or a event name.
+ */
+
+/// direction tags
+#define CAPTURE_TAG_RX   "RX"
+#define CAPTURE_TAG_TX   "TX"
+/// sniffer mode. A is --port and B is --sniff
+#define CAPTURE_TAG_A2B  "A>B"
+#define CAPTURE_TAG_B2A  "B>A"
+/// decoded frame, see frame.h
+#define CAPTURE_TAG_FRAME "FRM"
+/// generic event or marker
+#define CAPTURE_TAG_EVT  "EVT"
+
+void capture_init(void);
+void capture_cleanup(void);
+
+bool capture_is_enabled(void);
+
+/// data record. written as hex
+void capture_data(const char *tag, const void *data, size_t size);
+
+/// text record, e.g. a marker or event
+__attribute__((format(printf, 2, 3)))
+void capture_event(const char *tag, const char *fmt, ...);
+
+#endif
@@ -5,9 +5,18 @@ enum cmd_src_e {
     /// command string from startup cli or possibly config file
     CMD_SRC_OPT = 1,
     /// from config file
-    CMD_SRC_SHELL = 2
+    CMD_SRC_SHELL = 2,
+    /// from control socket
+    CMD_SRC_CTRL = 3
 };
 
+/// max number of opq items enqueued by a single command
+#define CMD_OPS_MAX 3
+
+/**
+ * parse command and enqueue its operations.
+ * @return zero on success or negative errno. nothing enqueued on error.
+ */
 int cmd_parse(enum cmd_src_e cmdsrc, char *cmdstr);
 
 /// return NULL terminated list of strings beginning with `s` 
@@ -0,0 +1,17 @@
+#ifndef CRC_INCLUDE_H_
+#define CRC_INCLUDE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// CRC-16/X-25, i.e. HDLC FCS-16. Transmitted least significant byte first
+uint16_t crc16_x25(const void *data, size_t size);
+
+/// CRC-16/MODBUS. Transmitted least significant byte first
+uint16_t crc16_modbus(const void *data, size_t size);
+
+/// CRC-32 (IEEE 802.3), i.e. HDLC FCS-32. Transmitted least significant byte
+/// first
+uint32_t crc32_ieee(const void *data, size_t size);
+
+#endif
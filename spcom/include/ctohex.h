@@ -4,4 +4,10 @@
 #define CTOHEX_BUF_SIZE  8
 int ctohex(char c, char *dest);
 
+/**
+ * precomputed lower case hex pairs "00" to "ff", not null terminated.
+ * pair for byte `b` at `ctohex_pairs[2 * b]`
+ */
+extern const char ctohex_pairs[];
+
 #endif
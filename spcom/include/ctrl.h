@@ -0,0 +1,11 @@
+#ifndef CTRL_INCLUDE_H_
+#define CTRL_INCLUDE_H_
+
+/**
+ * control socket. Commands (as in shell command mode) accepted on a local unix
+ * socket, e.g. from a test harness.
+ */
+void ctrl_init(void);
+void ctrl_cleanup(void);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef DETOK_INCLUDE_H_
+#define DETOK_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// true if dictionary loaded with `--detok`
+bool detok_is_enabled(void);
+
+void detok_cleanup(void);
+
+/**
+ * decode one tokenized message (complete frame) to text, without newline.
+ * unknown tokens decoded as a placeholder.
+ * @return length written to dst (null terminated) or negative errno
+ */
+int detok_decode(const void *data, size_t size, char *dst, size_t dstsize);
+
+#endif
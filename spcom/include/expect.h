@@ -0,0 +1,30 @@
+#ifndef EXPECT_INCLUDE_H_
+#define EXPECT_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct opq;
+
+/// seconds
+#define EXPECT_TIMEOUT_DEFAULT 10
+#define EXPECT_EXIT_CODE 1
+
+typedef void (expect_done_fn)(void);
+
+/**
+ * compile pattern and enqueue a OP_EXPECT operation.
+ * @param timeout_ms negative for default, zero for no timeout.
+ * @param exit_code exit code on timeout
+ * @return zero or negative errno. nothing enqueued on error.
+ */
+int expect_enqueue(struct opq *q, const char *pattern, bool literal,
+                   int timeout_ms, int exit_code);
+
+/// start matching. `done_cb` called on match. `data` from OP_EXPECT item
+void expect_start(void *data, expect_done_fn *done_cb);
+
+/// data received from port
+void expect_feed(const void *data, size_t size);
+
+#endif
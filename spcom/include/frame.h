@@ -0,0 +1,27 @@
+#ifndef FRAME_INCLUDE_H_
+#define FRAME_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct frame_stats_s {
+    size_t frames;
+    /// payload bytes
+    size_t bytes;
+    size_t crc_errors;
+    size_t encoding_errors;
+    size_t overruns;
+};
+
+void frame_init(void);
+void frame_cleanup(void);
+
+/// true if received data shown as frames (`--frame`) instead of outfmt
+bool frame_is_enabled(void);
+
+/// data received from port
+void frame_feed(const void *data, size_t size);
+
+const struct frame_stats_s *frame_stats(void);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HEXDUMP_INCLUDE_H_
+#define HEXDUMP_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void hexdump_init(void);
+
+bool hexdump_is_enabled(void);
+
+/// format and write received data. @param timestamp prepend on every row
+void hexdump_write(const void *data, size_t size, bool timestamp);
+
+/// write incomplete row, if any
+void hexdump_flush(void);
+
+#endif
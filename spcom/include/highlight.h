@@ -0,0 +1,16 @@
+#ifndef HIGHLIGHT_INCLUDE_H_
+#define HIGHLIGHT_INCLUDE_H_
+
+#include <stddef.h>
+
+/**
+ * rule based highlighting of received data. Set with `--highlight` or
+ * `--highlight-file`
+ */
+void highlight_init(void);
+void highlight_cleanup(void);
+
+/// data received from port. must be called before outfmt_write() of same data
+void highlight_feed(const void *data, size_t size);
+
+#endif
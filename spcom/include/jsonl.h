@@ -0,0 +1,28 @@
+#ifndef JSONL_INCLUDE_H_
+#define JSONL_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum jsonl_dir {
+    JSONL_DIR_RX = 0,
+    JSONL_DIR_TX,
+    JSONL_DIR_COUNT,
+};
+
+void jsonl_init(void);
+
+/// true if `--format jsonl`
+bool jsonl_is_enabled(void);
+
+/// data received or sent. one record written per line
+void jsonl_write(enum jsonl_dir dir, const void *data, size_t size);
+
+/// one record for a decoded frame, see frame.h
+void jsonl_frame(size_t num, const char *status, const void *data,
+                 size_t size);
+
+/// write incomplete lines, if any
+void jsonl_flush(void);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef LINEFILT_INCLUDE_H_
+#define LINEFILT_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool linefilt_is_enabled(void);
+
+/// @return true if line should be shown. `line` without eol
+bool linefilt_match(const char *line, size_t len);
+
+#endif
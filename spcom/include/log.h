@@ -6,15 +6,25 @@
 #include "misc.h"
 #include "common.h"
 
-#ifndef DEBUG
-#define DEBUG 0
-#endif
-
 #define LOG_LEVEL_ERR 1
 #define LOG_LEVEL_WRN 2
 #define LOG_LEVEL_INF 3
 #define LOG_LEVEL_DBG 4
 
+/// build time max level. log calls above it are removed by the compiler
+#ifndef CONFIG_LOG_LEVEL
+#define CONFIG_LOG_LEVEL LOG_LEVEL_DBG
+#endif
+
+/// runtime level, `--loglevel`
+extern int log_level;
+
+/// true if records of `level` are written anywhere, i.e. worth formatting
+static inline bool log_is_enabled(int level)
+{
+    return level <= CONFIG_LOG_LEVEL && level <= log_level;
+}
+
 void log_vprintf(int level,
                  const char *file,
                  unsigned int line,
@@ -28,8 +38,11 @@ void log_printf(int level,
                 const char *fmt,
                 ...);
 
+/// arguments not evaluated unless level enabled. expression, not statement
 #define ___LOG(LEVEL, FMT, ...)                                                 \
-    log_printf(LEVEL, FILEBASENAME(), __LINE__, FMT, ##__VA_ARGS__)
+    (log_is_enabled(LEVEL)                                                     \
+         ? log_printf(LEVEL, FILEBASENAME(), __LINE__, FMT, ##__VA_ARGS__)     \
+         : (void)0)
 
 #define LOG_ERR(FMT, ...) ___LOG(LOG_LEVEL_ERR, FMT, ##__VA_ARGS__)
 
@@ -54,8 +67,10 @@ static inline void ___log_int(int level,
                msg, num, num_str);
 }
 
-#define ___LOG_INT(LEVEL, MSG, NUM, NUM_TO_STR) \
-    ___log_int(LEVEL, FILEBASENAME(), __LINE__, MSG, NUM, NUM_TO_STR)
+#define ___LOG_INT(LEVEL, MSG, NUM, NUM_TO_STR)                                 \
+    (log_is_enabled(LEVEL)                                                     \
+         ? ___log_int(LEVEL, FILEBASENAME(), __LINE__, MSG, NUM, NUM_TO_STR)   \
+         : (void)0)
 
 #define LOG_ERRNO(ERRNUM, MSG) \
     ___LOG_INT(LOG_LEVEL_ERR, MSG, ERRNUM, strerrorname_np)
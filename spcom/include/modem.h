@@ -0,0 +1,19 @@
+#ifndef MODEM_INCLUDE_H_
+#define MODEM_INCLUDE_H_
+
+#include <stdbool.h>
+
+bool modem_is_enabled(void);
+
+void modem_init(void);
+
+/// stop monitor, if running
+void modem_cleanup(void);
+
+/// start monitor of CTS, DSR, DCD and RI on a open port
+void modem_start(int fd);
+
+/// stop monitor. must be called before `fd` closed
+void modem_stop(void);
+
+#endif
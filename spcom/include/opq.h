@@ -24,14 +24,25 @@ enum op_code_e {
     OP_PORT_BAUD,
     OP_PORT_FLOW,
     OP_PORT_PARITY,
+    OP_PORT_DATABITS,
+    OP_PORT_STOPBITS,
     OP_PORT_BREAK,
     OP_PORT_DRAIN,
     OP_PORT_FLUSH,
+    /// no-op. item free_cb called when reached, i.e. completion notification
+    OP_NOTIFY,
+    /// u.val milliseconds
     OP_SLEEP,
+    /// hold queue until pattern received. u.data see expect.h
+    OP_EXPECT,
     OP_EXIT
 };
 // clang-format on
 
+struct opq_item;
+
+typedef void (opq_free_cb)(const struct opq_item *itm);
+
 struct opq_item {
     uint16_t op_code;
     uint16_t size; //<! non-zero if u.data not NULL
@@ -40,10 +51,18 @@ struct opq_item {
         int val;
         void *data;
     } u;
+    /// per item callback on release. overrides queue callback if set
+    opq_free_cb *free_cb;
+    /**
+     * set when executed, before released. false in callback if released
+     * without, i.e. queue flushed on port close */
+    bool done;
+    /// write of data forwarded from another port, i.e. already captured
+    bool forwarded;
+    /// enqueue time, uv_hrtime()
+    uint64_t ts;
 };
 
-typedef void (opq_free_cb)(const struct opq_item *itm);
-
 /// oo - on open
 extern struct opq opq_oo;
 /// rt - runtime
@@ -56,6 +75,19 @@ void opq_set_free_cb(struct opq *q, opq_free_cb *cb);
 /// enqueue value
 int opq_enqueue_val(struct opq *q, uint16_t op_code, int val);
 
+/// enqueue value with its own free callback. non-zero if queue full
+int opq_enqueue_val_cb(struct opq *q, uint16_t op_code, int val,
+                       opq_free_cb *cb);
+
+/// number of items that can be enqueued
+unsigned int opq_space(const struct opq *q);
+
+/// number of items in queue, including the one in progress
+unsigned int opq_count(const struct opq *q);
+
+/// high water mark of opq_count()
+unsigned int opq_max_count(const struct opq *q);
+
 /**
  * enqueue a write operation. prior call to opq_set_free_cb might be
  * needed */
@@ -63,6 +95,16 @@ int opq_enqueue_write(struct opq *q,
                       void *data,
                       uint16_t size);
 
+/**
+ * enqueue a write operation with its own free callback. Used by data sources
+ * that do not own the queue, i.e. not the shell or inpipe.
+ * @return non-zero if queue full (callback not called in that case)
+ */
+int opq_enqueue_write_cb(struct opq *q,
+                         void *data,
+                         uint16_t size,
+                         opq_free_cb *cb);
+
 /**
  * peek and acquire tail without updating index. Returned item (unless NULL)
  * could be passed to opq_enqueue_tail() or ignored.  */
@@ -80,5 +122,12 @@ struct opq_item *opq_acquire_head(struct opq *q);
 void opq_release_head(struct opq *q, struct opq_item *itm);
 
 void opq_release_all(struct opq *q);
+
+/**
+ * move all items from `src` to end of `dst`. items not released, i.e. free
+ * callbacks called when released from `dst`.
+ * @return non-zero if `dst` full. remaining items left in `src`
+ */
+int opq_transfer(struct opq *dst, struct opq *src);
 #endif
 
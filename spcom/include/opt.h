@@ -94,6 +94,14 @@ int opt_parse_flag_false(const struct opt_conf *conf, char *s);
  */
 int opt_parse_flag_count(const struct opt_conf *conf, char *s);
 
+/**
+ * call line_cb for each line of file at path, stripped, skipping empty lines
+ * and `#` comments. For options reading rules from a file.
+ * @return non-zero on open error or line_cb failure
+ */
+int opt_parse_file_lines(const struct opt_conf *conf, const char *path,
+                         int (*line_cb)(char *s));
+
 /**
  * @}
  */
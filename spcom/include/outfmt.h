@@ -3,12 +3,39 @@
 
 #include <stddef.h>
 
+void outfmt_init(void);
+
 /**
  * format output. if no output format options is set, which might not be the
  * default, this function should be same as calling fwrite()
  */
 void outfmt_write(const void *data, size_t size);
 
+/**
+ * color bytes [start, end) of data passed to next call to outfmt_write().
+ * Overlapping or adjacent marks are merged.
+ */
+void outfmt_mark(size_t start, size_t end, const char *color);
+
+/**
+ * color the line containing byte `offset` of data passed to next call to
+ * outfmt_write(), from start of line (or as much as not already written) to
+ * end of line. First line mark on a line wins.
+ */
+void outfmt_mark_line(size_t offset, const char *color);
+
+/**
+ * drop marks not yet applied, i.e. data they refer to not passed to
+ * outfmt_write(), e.g. decoded by --frame instead
+ */
+void outfmt_marks_clear(void);
+
+/**
+ * write `text` on a line of its own between received data, e.g. a event.
+ * Not shown with --raw-out, --hexdump or --format jsonl.
+ */
+void outfmt_notice(const char *text);
+
 /**
  * end line if last char(s) to output was not new line (eol)
 */
@@ -1,14 +1,58 @@
 #ifndef PORT_INCLUDE_H_
 #define PORT_INCLUDE_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct sp_port;
+struct port_opts_s;
+
+/// kernel UART counters (TIOCGICOUNT)
+enum port_icount {
+    PORT_ICOUNT_RX = 0,
+    PORT_ICOUNT_TX,
+    PORT_ICOUNT_FRAME,
+    PORT_ICOUNT_OVERRUN,
+    PORT_ICOUNT_PARITY,
+    PORT_ICOUNT_BRK,
+    PORT_ICOUNT_BUF_OVERRUN,
+    PORT_ICOUNT_COUNT,
+};
+
+struct port_stats_s {
+    size_t rx_bytes;
+    size_t tx_bytes;
+    /// uv_hrtime() of last read
+    uint64_t rx_time;
+    /// kernel counters while open, i.e. sum of deltas. zero if not supported
+    size_t icount[PORT_ICOUNT_COUNT];
+    bool have_icount;
+};
+
 /** data only valid in callback and do not need to be freed */
 typedef void (port_rx_cb_fn)(const void *data, size_t size);
 void port_init(port_rx_cb_fn *rx_cb);
 void port_cleanup(void);
-// TODO
+/**
+ * non-blocking write directly to port, bypassing the operation queue.
+ * @return number of bytes written (zero if port busy) or negative on error or
+ * port not ready.
+ */
 int port_write(const void *data, size_t size);
 int port_putc(int c);
 /// write string and EOL
 int port_write_line(const char *line);
 
+/// "waiting", "ready" etc
+const char *port_state_str(void);
+
+const struct port_stats_s *port_stats(void);
+
+/// "overrun", "frame" etc
+const char *port_icount_str(enum port_icount idx);
+
+/// apply config to a open port. negative values in `cfg` left untouched
+int port_apply_config(struct sp_port *p, const struct port_opts_s *cfg);
+
 #endif
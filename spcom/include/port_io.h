@@ -0,0 +1,47 @@
+#ifndef PORT_IO_INCLUDE_H_
+#define PORT_IO_INCLUDE_H_
+
+#include <errno.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include <libserialport.h>
+
+#include "port_opts.h"
+
+/**
+ * port reads and writes. With `--direct-io` plain read(2) and write(2) on
+ * the port fd, i.e. no libserialport argument checks and debug hooks per
+ * call. libserialport still used for everything else.
+ *
+ * Return values same as sp_nonblocking_read() and sp_nonblocking_write(),
+ * i.e. bytes, zero if would block, or negative libserialport error with
+ * errno set.
+ */
+static inline int port_io_read(struct sp_port *port, int fd, void *buf,
+                               size_t size)
+{
+    if (!port_opts->direct_io)
+        return sp_nonblocking_read(port, buf, size);
+
+    ssize_t rc = read(fd, buf, size);
+    if (rc >= 0)
+        return rc;
+
+    return (errno == EAGAIN || errno == EINTR) ? 0 : SP_ERR_FAIL;
+}
+
+static inline int port_io_write(struct sp_port *port, int fd,
+                                const void *buf, size_t size)
+{
+    if (!port_opts->direct_io)
+        return sp_nonblocking_write(port, buf, size);
+
+    ssize_t rc = write(fd, buf, size);
+    if (rc >= 0)
+        return rc;
+
+    return (errno == EAGAIN || errno == EINTR) ? 0 : SP_ERR_FAIL;
+}
+
+#endif
@@ -17,11 +17,20 @@ struct port_opts_s {
     int chardelay;
     int wait;
     int stay;
+    int mark_errors;
+    int direct_io;
 };
 
 /// exposed const "getter" pointer
 extern const struct port_opts_s *port_opts;
 
+/**
+ * keep config changed at runtime, e.g. by a command or RFC 2217 client, so
+ * it is applied again on reconnect. Only baudrate, databits, parity, stopbits
+ * and flowcontrol. Negative values in @param cfg left untouched.
+ */
+void port_opts_update_config(const struct port_opts_s *cfg);
+
 int port_opts_parse_pinstate(const char *s, int *state);
 
 const char **port_opts_complete_pinstate(const char *s);
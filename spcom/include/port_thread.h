@@ -0,0 +1,31 @@
+#ifndef PORT_THREAD_INCLUDE_H_
+#define PORT_THREAD_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct sp_port;
+
+/// @param ts uv_hrtime() of read
+typedef void (port_thread_rx_fn)(const void *data, size_t size, uint64_t ts);
+
+/// @param err libserialport error, i.e. port gone
+typedef void (port_thread_err_fn)(int err);
+
+/// true if `--io-thread`
+bool port_thread_is_enabled(void);
+
+/// callbacks run on the event loop
+void port_thread_init(port_thread_rx_fn *rx_cb, port_thread_err_fn *err_cb);
+
+/// stop thread, if running
+void port_thread_cleanup(void);
+
+/// start reading `fd` of `port`, i.e. a open port, on a thread
+void port_thread_start(struct sp_port *port, int fd);
+
+/// stop reading. must be called before port closed
+void port_thread_stop(void);
+
+#endif
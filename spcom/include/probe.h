@@ -0,0 +1,42 @@
+/**
+ * USDT (user statically defined tracing) probes, e.g. for bpftrace:
+ *
+ *     bpftrace -e 'usdt:./spcom:spcom:port_read { @bytes = hist(arg0); }'
+ *     bpftrace -e 'usdt:./spcom:spcom:op_done { @ns[arg0] = hist(nsecs - arg1); }'
+ *
+ * A probe is a nop when not attached, and arguments are values already at
+ * hand. Provider `spcom`, probes and arguments:
+ *
+ *  - port_read(size)           bytes read from port
+ *  - port_write(size)          bytes written to port
+ *  - port_eagain(dir)          port read (0) or write (1) would block
+ *  - op_done(op_code, ts)      opq item done. ts is enqueue time, monotonic
+ *                              ns, i.e. queue latency is `nsecs - arg1`
+ *  - outfmt_flush(size)        bytes written to stdout
+ *  - port_open(name)           port opened. name is device path (string)
+ *  - port_close(name)          port closed
+ *  - port_wait_start(name)     waiting for port to appear
+ *  - port_discovered(err)      wait done. err non-zero on failure
+ *
+ * Requires `sys/sdt.h` (systemtap-sdt-dev) at build time, otherwise the
+ * probes are removed. cmake reports which at configure. Probes in a build
+ * are listed with `readelf -n spcom | grep stapsdt`.
+ */
+#ifndef PROBE_INCLUDE_H_
+#define PROBE_INCLUDE_H_
+
+#ifndef HAVE_SYS_SDT_H
+#define HAVE_SYS_SDT_H 0
+#endif
+
+#if HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PROBE1(NAME, A) DTRACE_PROBE1(spcom, NAME, A)
+#define PROBE2(NAME, A, B) DTRACE_PROBE2(spcom, NAME, A, B)
+#else
+#define PROBE1(NAME, A) do { } while (0)
+#define PROBE2(NAME, A, B) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef PTY_BRIDGE_INCLUDE_H_
+#define PTY_BRIDGE_INCLUDE_H_
+
+#include <stddef.h>
+
+/**
+ * pseudo-terminal bridge. Creates a pty that other tools can open as if it
+ * was the serial port while spcom keeps monitoring it. Data written to the
+ * pty is sent to the serial port and data received from serial port is
+ * copied to the pty.
+ */
+void pty_bridge_init(void);
+void pty_bridge_cleanup(void);
+
+/// forward data received from serial port to pty
+void pty_bridge_write(const void *data, size_t size);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef REALTIME_INCLUDE_H_
+#define REALTIME_INCLUDE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/// result of realtime_thread_init()
+struct realtime_status {
+    /// errno of failed step, zero if none
+    int affinity_err;
+    int sched_err;
+    /// granted, read back
+    int policy;
+    int prio;
+    /// number of cpus thread may run on. cpu if only one, else -1
+    int cpus;
+    int cpu;
+};
+
+/**
+ * lock memory and apply `--realtime` to calling thread, i.e. the event loop,
+ * unless port I/O on a thread. Must be called after other modules
+ * initialized, as memory allocated after is only locked, not prefaulted.
+ */
+void realtime_init(void);
+
+/**
+ * apply `--realtime` scheduling and affinity to calling thread. Does not log,
+ * i.e. may be called from any thread. Pass result to realtime_log() on the
+ * event loop.
+ *
+ * @return false if `--realtime` not set, i.e. nothing done
+ */
+bool realtime_thread_init(struct realtime_status *st);
+
+/// log result of realtime_thread_init(). event loop only
+void realtime_log(const struct realtime_status *st);
+
+/**
+ * init attributes for any thread created by spcom. Small stack and default
+ * policy and affinity, i.e. not inherited from a `--realtime` thread. Destroy
+ * with pthread_attr_destroy() after pthread_create().
+ */
+void realtime_thread_attr_init(pthread_attr_t *attr);
+
+#endif
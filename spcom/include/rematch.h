@@ -0,0 +1,63 @@
+#ifndef REMATCH_INCLUDE_H_
+#define REMATCH_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * incremental pattern matcher for streams. Bit-parallel NFA (shift-and) - each
+ * pattern position is one bit in a 64 bit state word, so every input byte is
+ * processed in constant time and nothing is buffered or re-scanned. Matches
+ * can span any number of chunks.
+ *
+ * Supported regex subset:
+ *  - literal characters and escapes `\n \r \t \e \0 \xHH` and `\<punct>`
+ *  - `.` any byte
+ *  - `[abc]`, `[a-z]`, `[^...]` character classes
+ *  - `\d \w \s` class shorthands
+ *  - `?`, `*`, `+` after any of the above
+ *
+ * No anchors, groups or alternation. At most REMATCH_POS_MAX positions.
+ */
+
+#define REMATCH_POS_MAX 63
+
+struct rematch {
+    /// bit j set if position j (1..) accepts byte. bit 0 is the start state
+    uint64_t table[256];
+    /// positions that may repeat (`+` and `*`)
+    uint64_t rep;
+    /// positions that may be skipped (`?` and `*`)
+    uint64_t opt;
+    /// bit before each block of optional positions
+    uint64_t opt_entry;
+    /// last bit of each block of optional positions
+    uint64_t opt_last;
+    uint64_t accept;
+    uint64_t state;
+};
+
+/**
+ * @param literal if true, no special characters.
+ * @return zero or negative errno on invalid or too long pattern
+ */
+int rematch_compile(struct rematch *re, const char *pattern, bool literal);
+
+void rematch_reset(struct rematch *re);
+
+/**
+ * feed data to matcher.
+ * @return number of bytes consumed up to and including the end of match, or
+ * zero if no match in data (all consumed). matcher reset on match.
+ */
+size_t rematch_feed(struct rematch *re, const void *data, size_t size);
+
+/**
+ * anchored match at start of data. matcher state not used or modified.
+ * @return length of longest match starting at data, or zero if none
+ */
+size_t rematch_match_at(const struct rematch *re, const void *data,
+                        size_t size);
+
+#endif
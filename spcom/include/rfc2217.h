@@ -0,0 +1,18 @@
+#ifndef RFC2217_INCLUDE_H_
+#define RFC2217_INCLUDE_H_
+
+#include <stddef.h>
+
+/**
+ * RFC 2217 (Telnet Com Port Control Option) server. Lets a remote client, for
+ * example pyserial `rfc2217://localhost:PORT`, use the serial port while spcom
+ * keeps monitoring it. Serial port settings requested by the client are
+ * converted to operations on the runtime opq.
+ */
+void rfc2217_init(void);
+void rfc2217_cleanup(void);
+
+/// forward data received from serial port to client (if any)
+void rfc2217_write(const void *data, size_t size);
+
+#endif
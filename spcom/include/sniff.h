@@ -0,0 +1,19 @@
+#ifndef SNIFF_INCLUDE_H_
+#define SNIFF_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * two-port sniffer. Data is forwarded between port (A) and a second port (B)
+ * in both directions, e.g. inserted between a device and its host.
+ */
+void sniff_init(void);
+void sniff_cleanup(void);
+
+bool sniff_is_active(void);
+
+/// forward data received from port A to port B
+void sniff_write(const void *data, size_t size);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef STATS_INCLUDE_H_
+#define STATS_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * log-linear histogram (as HDR histogram). values below STATS_HIST_SUB
+ * exact, above that STATS_HIST_SUB buckets per power of two, i.e. within
+ * 1/STATS_HIST_SUB of value. Covers all of uint64_t.
+ */
+#define STATS_HIST_SUB_BITS 3
+#define STATS_HIST_SUB (1u << STATS_HIST_SUB_BITS)
+#define STATS_HIST_LEN ((64 - STATS_HIST_SUB_BITS + 1) * STATS_HIST_SUB)
+
+struct stats_hist {
+    uint64_t count;
+    uint64_t max;
+    uint32_t buckets[STATS_HIST_LEN];
+};
+
+/// counters not in port_stats(). updated in place, read on display
+struct stats_s {
+    size_t rx_reads;
+    size_t tx_writes;
+    size_t rx_eagain;
+    size_t tx_eagain;
+    size_t flushes;
+    size_t flush_bytes;
+    /// ns in stdout write, i.e. blocked by terminal or pipe
+    uint64_t stdout_ns;
+    /// port thread ring full, see port_thread.c
+    size_t rx_ring_full;
+    size_t reconnects;
+    /// ns port gone, total and longest
+    uint64_t disconnected_ns;
+    uint64_t disconnected_max_ns;
+    /// bytes per read
+    struct stats_hist read_size;
+    /// ns from enqueue to written to port
+    struct stats_hist tx_latency;
+    /// ns from read to written to stdout
+    struct stats_hist rx_latency;
+    /// ns from modem line change wake up to shown, see modem.c
+    struct stats_hist modem_latency;
+};
+
+extern struct stats_s stats;
+
+static inline unsigned int stats_hist_idx(uint64_t v)
+{
+    if (v < STATS_HIST_SUB)
+        return v;
+
+    unsigned int shift = 63 - __builtin_clzll(v) - STATS_HIST_SUB_BITS;
+    return (shift + 1) * STATS_HIST_SUB
+           + ((v >> shift) & (STATS_HIST_SUB - 1));
+}
+
+static inline void stats_hist_add(struct stats_hist *h, uint64_t v)
+{
+    h->buckets[stats_hist_idx(v)]++;
+    h->count++;
+    h->max = (v > h->max) ? v : h->max;
+}
+
+/// for counters updated from other threads
+static inline void stats_add_atomic(size_t *counter, size_t n)
+{
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+/// value at quantile `q` [0, 1], lower bound of bucket
+uint64_t stats_hist_quantile(const struct stats_hist *h, double q);
+
+void stats_init(void);
+
+/// exit summary, if `--stats`
+void stats_cleanup(void);
+
+#endif
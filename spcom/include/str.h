@@ -124,4 +124,8 @@ int str_escape_nonprint(char *dst, size_t dstsize,
 #define STR_ISO8601_SHORT_SIZE (sizeof("19700101T010203Z.123456789") + 2)
 int str_iso8601_short(char *dst, size_t size);
 
+/// same as memmem(). SIMD compare of first and last byte if supported
+const char *str_memmem(const char *hay, size_t hlen, const char *needle,
+                       size_t nlen);
+
 #endif
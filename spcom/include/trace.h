@@ -0,0 +1,60 @@
+#ifndef TRACE_INCLUDE_H_
+#define TRACE_INCLUDE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// build time switch. zero removes all trace points
+#ifndef CONFIG_TRACE
+#define CONFIG_TRACE 1
+#endif
+
+enum trace_event {
+    /// arg: uv poll events
+    TRACE_PORT_POLL = 0,
+    /// arg: bytes read
+    TRACE_PORT_READ,
+    /// arg: bytes written
+    TRACE_PORT_WRITE,
+    /// arg: 0 read, 1 write
+    TRACE_PORT_EAGAIN,
+    /// arg: op code
+    TRACE_OPQ_ENQUEUE,
+    TRACE_OPQ_DEQUEUE,
+    /// arg: bytes written to stdout
+    TRACE_OUTFMT_FLUSH,
+    /// arg: enum trace_timer
+    TRACE_TIMER,
+    TRACE_SHELL_REDRAW,
+    TRACE_EVENT_COUNT,
+};
+
+enum trace_timer {
+    TRACE_TIMER_EOL_RX = 0,
+    TRACE_TIMER_PORT_SLEEP,
+    TRACE_TIMER_FRAME_GAP,
+    TRACE_TIMER_IDLE_FLUSH,
+};
+
+/// true if `--trace`. not to be used directly
+extern bool trace_on;
+
+void trace_init(void);
+
+/// write trace file, if enabled
+void trace_cleanup(void);
+
+/// append event to ring of calling thread
+void trace_record(enum trace_event event, uint32_t arg);
+
+#if CONFIG_TRACE
+#define TRACE(EVENT, ARG)                                                      \
+    do {                                                                       \
+        if (__builtin_expect(trace_on, 0))                                     \
+            trace_record(EVENT, ARG);                                          \
+    } while (0)
+#else
+#define TRACE(EVENT, ARG) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef TRIGGER_INCLUDE_H_
+#define TRIGGER_INCLUDE_H_
+
+#include <stddef.h>
+
+/**
+ * keyword triggers on received data. Set with `--trigger` or
+ * `--trigger-file`
+ */
+void trigger_init(void);
+void trigger_cleanup(void);
+
+/// data received from port. must be called before outfmt_write() of same data
+void trigger_feed(const void *data, size_t size);
+
+/// highest exit code of triggers matched, or zero
+int trigger_exit_code(void);
+
+#endif
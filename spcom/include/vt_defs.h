@@ -11,6 +11,8 @@
 #define VT_COLOR_GREEN      "\001\x1B[0;92m\002"
 #define VT_COLOR_YELLOW     "\001\x1B[0;93m\002"
 #define VT_COLOR_BLUE       "\001\x1B[0;94m\002"
+#define VT_COLOR_MAGENTA    "\001\x1B[0;95m\002"
+#define VT_COLOR_CYAN       "\001\x1B[0;96m\002"
 #define VT_COLOR_BOLDGRAY   "\001\x1B[1;30m\002"
 #define VT_COLOR_BOLDWHITE  "\001\x1B[1;37m\002"
 #define VT_COLOR_HIGHLIGHT  "\001\x1B[1;39m\002"
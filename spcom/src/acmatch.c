@@ -0,0 +1,231 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+// local
+#include "assert.h"
+#include "acmatch.h"
+
+/// transition to a state with output (match)
+#define AC_ACCEPT ((uint32_t)1 << 31)
+#define AC_ROW_MASK (~AC_ACCEPT)
+
+struct ac_pattern {
+    const unsigned char *data;
+    size_t len;
+};
+
+struct acmatch {
+    // patterns added
+    struct ac_pattern *patterns;
+    int npatterns;
+    size_t totlen;
+    // compiled
+    bool compiled;
+    unsigned int nclasses;
+    unsigned int nstates;
+    uint8_t classes[256];
+    /**
+     * DFA. entry is the row offset (state * nclasses) of the next state, or'ed
+     * with AC_ACCEPT if next state has output. saves a multiply and a lookup
+     * per byte */
+    uint32_t *delta;
+    /// first pattern id ending in state, -1 if none
+    int *out_first;
+    /// next pattern id ending in same state (duplicates)
+    int *id_next;
+    /// nearest state on fail path with output, -1 if none
+    int *dict;
+    /// current row offset
+    uint32_t row;
+};
+
+struct acmatch *acmatch_new(void)
+{
+    struct acmatch *ac = calloc(1, sizeof(*ac));
+    assert(ac);
+    return ac;
+}
+
+void acmatch_free(struct acmatch *ac)
+{
+    if (!ac)
+        return;
+
+    for (int i = 0; i < ac->npatterns; i++)
+        free((void *)ac->patterns[i].data);
+
+    free(ac->patterns);
+    free(ac->delta);
+    free(ac->out_first);
+    free(ac->id_next);
+    free(ac->dict);
+    free(ac);
+}
+
+int acmatch_add(struct acmatch *ac, const void *pattern, size_t len)
+{
+    if (ac->compiled || !len)
+        return -EINVAL;
+
+    int n = ac->npatterns;
+    ac->patterns = realloc(ac->patterns, (n + 1) * sizeof(*ac->patterns));
+    assert(ac->patterns);
+
+    unsigned char *copy = malloc(len);
+    assert(copy);
+    memcpy(copy, pattern, len);
+
+    ac->patterns[n].data = copy;
+    ac->patterns[n].len = len;
+    ac->npatterns++;
+    ac->totlen += len;
+
+    return n;
+}
+
+size_t acmatch_pattern_len(const struct acmatch *ac, int id)
+{
+    assert(id >= 0 && id < ac->npatterns);
+    return ac->patterns[id].len;
+}
+
+/// every byte used in a pattern gets its own class. all others class 0
+static void _build_classes(struct acmatch *ac)
+{
+    bool used[256] = { 0 };
+
+    for (int i = 0; i < ac->npatterns; i++) {
+        const struct ac_pattern *p = &ac->patterns[i];
+        for (size_t j = 0; j < p->len; j++)
+            used[p->data[j]] = true;
+    }
+
+    ac->nclasses = 1;
+    for (int c = 0; c < 256; c++)
+        ac->classes[c] = used[c] ? ac->nclasses++ : 0;
+}
+
+int acmatch_compile(struct acmatch *ac)
+{
+    if (ac->compiled || !ac->npatterns)
+        return -EINVAL;
+
+    _build_classes(ac);
+
+    const unsigned int nc = ac->nclasses;
+    const size_t maxstates = ac->totlen + 1;
+
+    if ((uint64_t)maxstates * nc > AC_ROW_MASK)
+        return -E2BIG;
+
+    // trie. zero is "no child" as root is never a child
+    uint32_t *go = calloc(maxstates * nc, sizeof(*go));
+    int *fail = calloc(maxstates, sizeof(*fail));
+    int *queue = malloc(maxstates * sizeof(*queue));
+    ac->out_first = malloc(maxstates * sizeof(*ac->out_first));
+    ac->dict = malloc(maxstates * sizeof(*ac->dict));
+    ac->id_next = malloc(ac->npatterns * sizeof(*ac->id_next));
+    assert(go && fail && queue && ac->out_first && ac->dict && ac->id_next);
+
+    for (size_t s = 0; s < maxstates; s++) {
+        ac->out_first[s] = -1;
+        ac->dict[s] = -1;
+    }
+
+    unsigned int nstates = 1;
+    for (int id = 0; id < ac->npatterns; id++) {
+        const struct ac_pattern *p = &ac->patterns[id];
+        uint32_t s = 0;
+        for (size_t j = 0; j < p->len; j++) {
+            uint32_t *child = &go[s * nc + ac->classes[p->data[j]]];
+            if (!*child)
+                *child = nstates++;
+            s = *child;
+        }
+        ac->id_next[id] = ac->out_first[s];
+        ac->out_first[s] = id;
+    }
+
+    /* BFS. missing transitions filled from fail state, which is already
+     * complete as it is closer to root */
+    int head = 0;
+    int tail = 0;
+    for (unsigned int c = 0; c < nc; c++) {
+        uint32_t t = go[c];
+        if (t) {
+            fail[t] = 0;
+            queue[tail++] = t;
+        }
+    }
+
+    while (head < tail) {
+        int s = queue[head++];
+        int f = fail[s];
+
+        ac->dict[s] = (ac->out_first[f] >= 0) ? f : ac->dict[f];
+
+        for (unsigned int c = 0; c < nc; c++) {
+            uint32_t *t = &go[s * nc + c];
+            if (*t) {
+                fail[*t] = go[f * nc + c];
+                queue[tail++] = *t;
+            }
+            else {
+                *t = go[f * nc + c];
+            }
+        }
+    }
+
+    // final table of row offsets
+    ac->delta = malloc((size_t)nstates * nc * sizeof(*ac->delta));
+    assert(ac->delta);
+
+    for (size_t i = 0; i < (size_t)nstates * nc; i++) {
+        uint32_t t = go[i];
+        uint32_t e = t * nc;
+        if (ac->out_first[t] >= 0 || ac->dict[t] >= 0)
+            e |= AC_ACCEPT;
+        ac->delta[i] = e;
+    }
+
+    free(go);
+    free(fail);
+    free(queue);
+
+    ac->nstates = nstates;
+    ac->row = 0;
+    ac->compiled = true;
+
+    return 0;
+}
+
+static void _report(const struct acmatch *ac, int s, size_t end,
+                    acmatch_cb *cb, void *arg)
+{
+    for (; s >= 0; s = ac->dict[s]) {
+        for (int id = ac->out_first[s]; id >= 0; id = ac->id_next[id])
+            cb(id, end, arg);
+    }
+}
+
+void acmatch_feed(struct acmatch *ac, const void *data, size_t size,
+                  acmatch_cb *cb, void *arg)
+{
+    const unsigned char *p = data;
+    const uint32_t *delta = ac->delta;
+    const uint8_t *classes = ac->classes;
+    uint32_t row = ac->row;
+
+    assert(ac->compiled);
+
+    for (size_t i = 0; i < size; i++) {
+        uint32_t e = delta[row + classes[p[i]]];
+        row = e & AC_ROW_MASK;
+        if (__builtin_expect(e & AC_ACCEPT, 0))
+            _report(ac, row / ac->nclasses, i + 1, cb, arg);
+    }
+
+    ac->row = row;
+}
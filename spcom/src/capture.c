@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "log.h"
+#include "opt.h"
+#include "capture.h"
+
+/// large stdio buffer - records are written on every read from port
+#define CAPTURE_FILE_BUF_SIZE (64 * 1024)
+
+static struct capture_opts_s {
+    const char *file;
+} capture_opts;
+
+static struct capture_s {
+    FILE *fp;
+    char *fbuf;
+} capture_data_s;
+
+bool capture_is_enabled(void)
+{
+    return capture_data_s.fp != NULL;
+}
+
+static void _put_header(FILE *fp, const char *tag)
+{
+    struct timespec now;
+    int err = clock_gettime(CLOCK_REALTIME, &now);
+    (void)err; // should not fail
+
+    fprintf(fp, "%lld.%06ld %s ", (long long)now.tv_sec,
+            now.tv_nsec / 1000, tag);
+}
+
+void capture_data(const char *tag, const void *data, size_t size)
+{
+    static const char hexlut[] = "0123456789abcdef";
+    FILE *fp = capture_data_s.fp;
+
+    if (!fp || !size)
+        return;
+
+    _put_header(fp, tag);
+
+    const unsigned char *src = data;
+    char buf[256];
+    while (size) {
+        size_t n = (size < sizeof(buf) / 2) ? size : sizeof(buf) / 2;
+        char *p = buf;
+        for (size_t i = 0; i < n; i++) {
+            *p++ = hexlut[src[i] >> 4];
+            *p++ = hexlut[src[i] & 0x0f];
+        }
+        fwrite(buf, 1, p - buf, fp);
+        src += n;
+        size -= n;
+    }
+
+    fputc('\n', fp);
+}
+
+void capture_event(const char *tag, const char *fmt, ...)
+{
+    FILE *fp = capture_data_s.fp;
+
+    if (!fp)
+        return;
+
+    _put_header(fp, tag);
+
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(fp, fmt, args);
+    va_end(args);
+
+    fputc('\n', fp);
+}
+
+void capture_init(void)
+{
+    const char *fpath = capture_opts.file;
+    if (!fpath)
+        return;
+
+    FILE *fp = fopen(fpath, "w");
+    if (!fp) {
+        int exit_code = (errno == EACCES) ? EX_NOPERM : EX_USAGE;
+        SPCOM_EXIT(exit_code, "Failed to open capture file %s '%s'", fpath,
+                   strerror(errno));
+        return;
+    }
+
+    capture_data_s.fbuf = malloc(CAPTURE_FILE_BUF_SIZE);
+    assert(capture_data_s.fbuf);
+    setvbuf(fp, capture_data_s.fbuf, _IOFBF, CAPTURE_FILE_BUF_SIZE);
+
+    capture_data_s.fp = fp;
+    LOG_DBG("capture to %s", fpath);
+}
+
+void capture_cleanup(void)
+{
+    if (capture_data_s.fp) {
+        fclose(capture_data_s.fp);
+        capture_data_s.fp = NULL;
+    }
+
+    if (capture_data_s.fbuf) {
+        free(capture_data_s.fbuf);
+        capture_data_s.fbuf = NULL;
+    }
+}
+
+static const struct opt_conf capture_opts_conf[] = {
+    {
+        .name = "capture",
+        .dest = &capture_opts.file,
+        .parse = opt_parse_str,
+        .metavar = "FILE",
+        .descr = "record all received and sent data, with timestamp and "
+                 "direction, to file. Not affected by display options",
+    },
+};
+
+OPT_SECTION_ADD(capture,
+                capture_opts_conf,
+                ARRAY_LEN(capture_opts_conf),
+                NULL);
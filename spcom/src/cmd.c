@@ -1,5 +1,6 @@
 
 #include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,7 +12,9 @@
 #include "common.h"
 #include "opq.h"
 #include "str.h"
+#include "strto.h"
 #include "cmd.h"
+#include "expect.h"
 #include "port_opts.h"
 
 struct cmd_ap_s {
@@ -58,29 +61,182 @@ static CMD_FUNC(_cmd_drain)
 {
     return opq_enqueue_val(ap->q, OP_PORT_DRAIN, 0);
 }
-static CMD_FUNC(_cmd_break)
+/// default break duration
+#define CMD_BREAK_MS 250
+
+static int _cmd_argc_check(struct cmd_ap_s *ap, int min, int max)
 {
-    // TODO
+    if (ap->argc - 1 < min) {
+        LOG_ERR("%s: missing argument", ap->argv[0]);
+        return -EINVAL;
+    }
+
+    if (ap->argc - 1 > max) {
+        LOG_ERR("%s: too many arguments", ap->argv[0]);
+        return -EINVAL;
+    }
+
     return 0;
 }
+
+static CMD_FUNC(_cmd_break)
+{
+    int ms = CMD_BREAK_MS;
+    int err = _cmd_argc_check(ap, 0, 1);
+    if (err)
+        return err;
+
+    if (ap->argc > 1) {
+        err = strto_i(ap->argv[1], NULL, 10, &ms);
+        if (err || ms <= 0) {
+            LOG_ERR("invalid break duration '%s'", ap->argv[1]);
+            return -EINVAL;
+        }
+    }
+
+    opq_enqueue_val(ap->q, OP_PORT_BREAK, 1);
+    opq_enqueue_val(ap->q, OP_SLEEP, ms);
+    return opq_enqueue_val(ap->q, OP_PORT_BREAK, 0);
+}
+
 static CMD_FUNC(_cmd_parity)
 {
-    // TODO port_opts_parse_parity
-    return 0;
+    int parity;
+    int err = _cmd_argc_check(ap, 1, 1);
+    if (err)
+        return err;
+
+    err = port_opts_parse_parity(ap->argv[1], &parity, NULL);
+    if (err) {
+        LOG_ERR("invalid parity '%s'", ap->argv[1]);
+        return -EINVAL;
+    }
+
+    return opq_enqueue_val(ap->q, cmd->opcode, parity);
 }
+
 static CMD_FUNC(_cmd_flow)
 {
-    // TODO port_opts_parse_flowcontrol
-    return 0;
+    int flow;
+    int err = _cmd_argc_check(ap, 1, 1);
+    if (err)
+        return err;
+
+    err = port_opts_parse_flowcontrol(ap->argv[1], &flow);
+    if (err) {
+        LOG_ERR("invalid flow control '%s'", ap->argv[1]);
+        return -EINVAL;
+    }
+
+    return opq_enqueue_val(ap->q, cmd->opcode, flow);
 }
-static CMD_FUNC(_cmd_set_pinstate) 
+
+static CMD_FUNC(_cmd_set_pinstate)
 {
-    return 0;
+    int state;
+    int err = _cmd_argc_check(ap, 1, 1);
+    if (err)
+        return err;
+
+    err = port_opts_parse_pinstate(ap->argv[1], &state);
+    if (err) {
+        LOG_ERR("invalid pin state '%s'", ap->argv[1]);
+        return -EINVAL;
+    }
+
+    return opq_enqueue_val(ap->q, cmd->opcode, state);
 }
 
 static CMD_FUNC(_cmd_baud)
 {
-    return 0;
+    int baud;
+    int err = _cmd_argc_check(ap, 1, 1);
+    if (err)
+        return err;
+
+    err = port_opts_parse_baud(ap->argv[1], &baud, NULL);
+    if (err) {
+        LOG_ERR("invalid baudrate '%s'", ap->argv[1]);
+        return -EINVAL;
+    }
+
+    return opq_enqueue_val(ap->q, cmd->opcode, baud);
+}
+
+static int _hexval(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20; // lower case
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/// hex pairs, optionally space separated, e.g. "0a0b" or "0a 0b"
+static int _decode_hex(char *dst, const char *s)
+{
+    int n = 0;
+    while (*s) {
+        if (*s == ' ') {
+            s++;
+            continue;
+        }
+
+        int hi = _hexval(s[0]);
+        int lo = (hi < 0) ? -1 : _hexval(s[1]);
+        if (lo < 0)
+            return -EINVAL;
+
+        dst[n++] = (hi << 4) | lo;
+        s += 2;
+    }
+
+    return n;
+}
+
+/// backslash escapes as in `echo -e`. subset: \\ \a \b \e \n \r \t \0 \xHH
+static int _decode_escaped(char *dst, const char *s)
+{
+    int n = 0;
+    while (*s) {
+        if (*s != '\\') {
+            dst[n++] = *s++;
+            continue;
+        }
+
+        s++;
+        switch (*s) {
+            case '\\': dst[n++] = '\\'; break;
+            case 'a':  dst[n++] = '\a'; break;
+            case 'b':  dst[n++] = '\b'; break;
+            case 'e':  dst[n++] = 0x1b; break;
+            case 'n':  dst[n++] = '\n'; break;
+            case 'r':  dst[n++] = '\r'; break;
+            case 't':  dst[n++] = '\t'; break;
+            case '0':  dst[n++] = '\0'; break;
+            case 'x': {
+                int hi = _hexval(s[1]);
+                int lo = (hi < 0) ? -1 : _hexval(s[2]);
+                if (lo < 0)
+                    return -EINVAL;
+                dst[n++] = (hi << 4) | lo;
+                s += 2;
+                break;
+            }
+            default:
+                return -EINVAL;
+        }
+        s++;
+    }
+
+    return n;
+}
+
+/// free data of write ops enqueued by commands
+static void _cmd_free_cb(const struct opq_item *itm)
+{
+    free(itm->u.data);
 }
 
 static CMD_FUNC(_cmd_send)
@@ -119,31 +275,136 @@ static CMD_FUNC(_cmd_send)
         return -EINVAL;
     }
 
+    // decoded size never larger than input. args joined by space as `echo`
+    size_t bufsize = 0;
+    for (int i = optind; i < ap->argc; i++)
+        bufsize += strlen(ap->argv[i]) + 1;
+
+    char *buf = malloc(bufsize);
+    assert(buf);
+
+    size_t size = 0;
     while (optind < ap->argc) {
         const char *arg  = ap->argv[optind++];
-        //LOG_DBG("optind:%d, argv:%s", optind, arg);
-        // TODO opq_enqueue_val(ap->q, OP_PORT_WRITE, ...);
+        int rc;
+
+        if (hexfmt) {
+            rc = _decode_hex(&buf[size], arg);
+        }
+        else if (escaped) {
+            rc = _decode_escaped(&buf[size], arg);
+        }
+        else {
+            rc = strlen(arg);
+            memcpy(&buf[size], arg, rc);
+        }
+
+        if (rc < 0) {
+            LOG_ERR("invalid send argument '%s'", arg);
+            free(buf);
+            return -EINVAL;
+        }
+        size += rc;
 
+        // space in hex input ignored
+        if (!hexfmt && optind < ap->argc)
+            buf[size++] = ' ';
     }
 
+    if (size > UINT16_MAX) {
+        LOG_ERR("send argument too long");
+        free(buf);
+        return -EINVAL;
+    }
+
+    if (size)
+        opq_enqueue_write_cb(ap->q, buf, size, _cmd_free_cb);
+    else
+        free(buf);
+
     if (sendeol)
         opq_enqueue_val(ap->q, OP_PORT_PUT_EOL, 1);
 
     return 0;
 }
 
+static CMD_FUNC(_cmd_sleep)
+{
+    float sec;
+    int err = _cmd_argc_check(ap, 1, 1);
+    if (err)
+        return err;
 
-static CMD_FUNC(_cmd_sleep) 
+    err = strto_f(ap->argv[1], NULL, 0, &sec);
+    if (err || sec < 0 || sec > (INT_MAX / 1000)) {
+        LOG_ERR("invalid sleep duration '%s'", ap->argv[1]);
+        return -EINVAL;
+    }
+
+    return opq_enqueue_val(ap->q, OP_SLEEP, (int)(sec * 1000));
+}
+
+static CMD_FUNC(_cmd_expect)
 {
-    LOG_DBG("TODO"); // TODO
-    return 0;
+    bool literal = true;
+    int timeout_ms = -1; // default
+    int exit_code = EXPECT_EXIT_CODE;
+    float sec;
+    int opt;
+    // optind not reseted by getopt
+    optind = 1;
+    while ((opt = getopt(ap->argc, ap->argv, "rt:c:")) != -1) {
+        switch(opt) {
+            case 'r':
+                literal = false;
+                break;
+            case 't':
+                if (strto_f(optarg, NULL, 0, &sec) || sec < 0
+                    || sec > (INT_MAX / 1000)) {
+                    LOG_ERR("invalid timeout '%s'", optarg);
+                    return -EINVAL;
+                }
+                timeout_ms = sec * 1000;
+                break;
+            case 'c':
+                if (strto_i(optarg, NULL, 0, &exit_code)) {
+                    LOG_ERR("invalid exit code '%s'", optarg);
+                    return -EINVAL;
+                }
+                break;
+            default:
+                LOG_ERR("invalid expect flags");
+                return -EINVAL;
+        }
+    }
+
+    if (optind != ap->argc - 1) {
+        LOG_ERR("expected one pattern argument");
+        return -EINVAL;
+    }
+
+    return expect_enqueue(ap->q, ap->argv[optind], literal, timeout_ms,
+                          exit_code);
 }
 
-static CMD_FUNC(_cmd_exit) 
+static CMD_FUNC(_cmd_exit)
 {
-    // TODO exit depending on cmd src
-    SPCOM_EXIT(0, "user cmd");
-    return 0;
+    int exit_code = EX_OK;
+    int err = _cmd_argc_check(ap, 0, 1);
+    if (err)
+        return err;
+
+    if (ap->argc > 1 && strto_i(ap->argv[1], NULL, 0, &exit_code)) {
+        LOG_ERR("invalid exit code '%s'", ap->argv[1]);
+        return -EINVAL;
+    }
+
+    // user typing exit expect it to be immediate
+    if (ap->cmdsrc == CMD_SRC_SHELL)
+        SPCOM_EXIT(exit_code, "user cmd");
+
+    // after any previous commands
+    return opq_enqueue_val(ap->q, OP_EXIT, exit_code);
 }
 
 static struct cmd_s _cmds[] = {
@@ -169,8 +430,10 @@ static struct cmd_s _cmds[] = {
     },
     {
         .opcode = OP_PORT_BREAK,
-        .name = "break", //"break",
-        .callback = _cmd_break
+        .name = "break",
+        .callback = _cmd_break,
+        .usage = "break [MS]\n"\
+        "send break condition for MS milliseconds (default 250)\n"
     },
     {
         .opcode = OP_PORT_SET_RTS,
@@ -216,17 +479,31 @@ static struct cmd_s _cmds[] = {
     {
         .opcode = OP_PORT_FLOW,
         .name = "flow",
-        .callback = _cmd_flow
+        .callback = _cmd_flow,
+        .complete = port_opts_complete_flowcontrol,
     },
     {
         .opcode = OP_SLEEP,
         .name = "sleep",
-        .callback = _cmd_sleep
+        .callback = _cmd_sleep,
+        .usage = "sleep SECONDS\n"\
+        "hold all following commands and writes. fractions allowed\n"
+    },
+    {
+        .opcode = OP_EXPECT,
+        .name = "expect",
+        .callback = _cmd_expect,
+        .usage = "expect [-r] [-t SECONDS] [-c CODE] PATTERN\n"\
+        "hold all following commands until PATTERN received.\n"\
+        "`-r` PATTERN is a regex (subset), see rematch.h\n"\
+        "`-t` timeout. zero waits forever\n"\
+        "`-c` exit code on timeout (default 1)\n"
     },
     {
         .opcode = OP_EXIT,
         .name = "exit",
-        .callback = _cmd_exit
+        .callback = _cmd_exit,
+        .usage = "exit [CODE]\n"
     }
 };
 
@@ -306,12 +583,12 @@ int cmd_parse(enum cmd_src_e cmdsrc, char *s)
 
     if (ap->argc <= 0) {
         LOG_ERR("no command name");
-        return -1;
+        return -EINVAL;
     }
 
     if (ap->argc > (ARRAY_LEN(ap->argv) - 1)) {
         LOG_ERR("too many args");
-        return -1;
+        return -E2BIG;
     }
 
     struct cmd_s *cmd = cmd_find(ap->argv[0]);
@@ -322,6 +599,7 @@ int cmd_parse(enum cmd_src_e cmdsrc, char *s)
 
     switch (cmdsrc) {
         case CMD_SRC_SHELL:
+        case CMD_SRC_CTRL:
             ap->q = &opq_rt;
             break;
         case CMD_SRC_OPT:
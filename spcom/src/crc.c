@@ -0,0 +1,92 @@
+/**
+ * table driven CRC, slice-by-8. Both CRCs are reflected, so the same kernel
+ * is used for the 16 bit CRC with the register in the low bits.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+// local
+#include "crc.h"
+
+#define CRC16_X25_POLY 0x8408 // 0x1021 reflected
+#define CRC16_MODBUS_POLY 0xa001 // 0x8005 reflected
+#define CRC32_IEEE_POLY 0xedb88320 // 0x04c11db7 reflected
+
+struct crc_table {
+    bool initialized;
+    uint32_t t[8][256];
+};
+
+static struct crc_table crc16_x25_table;
+static struct crc_table crc16_modbus_table;
+static struct crc_table crc32_ieee_table;
+
+static void _table_init(struct crc_table *tbl, uint32_t poly)
+{
+    for (unsigned int i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        tbl->t[0][i] = crc;
+    }
+
+    for (unsigned int i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = tbl->t[k - 1][i];
+            tbl->t[k][i] = (prev >> 8) ^ tbl->t[0][prev & 0xff];
+        }
+    }
+
+    tbl->initialized = true;
+}
+
+static uint32_t _crc_slice8(const struct crc_table *tbl, uint32_t crc,
+                            const unsigned char *p, size_t size)
+{
+    const uint32_t(*t)[256] = tbl->t;
+
+    for (; size >= 8; p += 8, size -= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff]
+              ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+              ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff]
+              ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+
+    while (size--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+
+    return crc;
+}
+
+uint16_t crc16_x25(const void *data, size_t size)
+{
+    if (!crc16_x25_table.initialized)
+        _table_init(&crc16_x25_table, CRC16_X25_POLY);
+
+    return _crc_slice8(&crc16_x25_table, 0xffff, data, size) ^ 0xffff;
+}
+
+uint16_t crc16_modbus(const void *data, size_t size)
+{
+    if (!crc16_modbus_table.initialized)
+        _table_init(&crc16_modbus_table, CRC16_MODBUS_POLY);
+
+    return _crc_slice8(&crc16_modbus_table, 0xffff, data, size);
+}
+
+uint32_t crc32_ieee(const void *data, size_t size)
+{
+    if (!crc32_ieee_table.initialized)
+        _table_init(&crc32_ieee_table, CRC32_IEEE_POLY);
+
+    return _crc_slice8(&crc32_ieee_table, 0xffffffff, data, size) ^ 0xffffffff;
+}
@@ -22,6 +22,16 @@ struct ctohex_table_s {
 
 static struct ctohex_table_s *ctohex_table = NULL;
 
+#define _PAIRS16(H)                                                            \
+    H "0" H "1" H "2" H "3" H "4" H "5" H "6" H "7"                            \
+    H "8" H "9" H "a" H "b" H "c" H "d" H "e" H "f"
+
+const char ctohex_pairs[] =
+    _PAIRS16("0") _PAIRS16("1") _PAIRS16("2") _PAIRS16("3")
+    _PAIRS16("4") _PAIRS16("5") _PAIRS16("6") _PAIRS16("7")
+    _PAIRS16("8") _PAIRS16("9") _PAIRS16("a") _PAIRS16("b")
+    _PAIRS16("c") _PAIRS16("d") _PAIRS16("e") _PAIRS16("f");
+
 static struct {
     char hexfmt[16];
 } ctohex_opts = {0};
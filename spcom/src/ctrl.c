@@ -0,0 +1,366 @@
+/**
+ * control socket. Local unix socket accepting the same commands as the shell,
+ * one per line, e.g. from a test harness while a user keeps the interactive
+ * session.
+ *
+ * Each request line is assigned a sequence number (per client, starting at 1)
+ * and answered with exactly one line:
+ *
+ *     OK <seq> [key=value ...]
+ *     ERR <seq> <errname>
+ *
+ * Commands are parsed when received, and the resulting operations enqueued on
+ * opq_rt followed by a OP_NOTIFY item. "OK" is sent when the notify item is
+ * reached, i.e. when all operations of that command are done. If the queue
+ * is flushed before, i.e. port closed, "ERR <seq> dropped" is sent instead.
+ * `state` and `stats` are answered immediately.
+ */
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+// deps
+#include <uv.h>
+// local
+#include "assert.h"
+#include "cmd.h"
+#include "common.h"
+#include "ctrl.h"
+#include "frame.h"
+#include "log.h"
+#include "opq.h"
+#include "opt.h"
+#include "port.h"
+#include "port_opts.h"
+#include "str.h"
+
+#define CTRL_LINE_MAX 512
+#define CTRL_RDBUF_SIZE 1024
+#define CTRL_REPLY_MAX 256
+/// notify value is client id and sequence number
+#define CTRL_ID_MAX 0x7fff
+#define CTRL_SEQ_MASK 0xffff
+
+struct ctrl_client {
+    uv_pipe_t handle;
+    struct ctrl_client *next;
+    unsigned int id;
+    unsigned int seq;
+    bool overflow;
+    size_t len;
+    char line[CTRL_LINE_MAX];
+};
+
+struct ctrl_reply {
+    uv_write_t req;
+    char data[CTRL_REPLY_MAX];
+};
+
+static struct ctrl_opts_s {
+    const char *path;
+} ctrl_opts;
+
+static struct ctrl_s {
+    bool initialized;
+    uv_pipe_t server;
+    struct ctrl_client *clients;
+    unsigned int next_id;
+} ctrl_data;
+
+static void _on_reply_written(uv_write_t *req, int status)
+{
+    if (status)
+        LOG_UV_DBG(status, "ctrl write");
+
+    free(req);
+}
+
+__attribute__((format(printf, 2, 3)))
+static void _reply(struct ctrl_client *c, const char *fmt, ...)
+{
+    struct ctrl_reply *r = malloc(sizeof(*r));
+    assert(r);
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(r->data, sizeof(r->data) - 1, fmt, args);
+    va_end(args);
+
+    if (n < 0)
+        n = 0;
+    else if (n > sizeof(r->data) - 2)
+        n = sizeof(r->data) - 2;
+    r->data[n++] = '\n';
+
+    uv_buf_t buf = uv_buf_init(r->data, n);
+    int err = uv_write(&r->req, (uv_stream_t *)&c->handle, &buf, 1,
+                       _on_reply_written);
+    if (err) {
+        LOG_UV_DBG(err, "ctrl uv_write");
+        free(r);
+    }
+}
+
+static struct ctrl_client *_client_find(unsigned int id)
+{
+    for (struct ctrl_client *c = ctrl_data.clients; c; c = c->next) {
+        if (c->id == id)
+            return c;
+    }
+
+    return NULL;
+}
+
+static void _on_notify(const struct opq_item *itm)
+{
+    unsigned int id = (unsigned int)itm->u.val >> 16;
+    unsigned int seq = itm->u.val & CTRL_SEQ_MASK;
+
+    // client might have disconnected
+    struct ctrl_client *c = _client_find(id);
+    if (!c)
+        return;
+
+    // not done if queue flushed, i.e. prior commands did not run either
+    if (itm->done)
+        _reply(c, "OK %u", seq);
+    else
+        _reply(c, "ERR %u dropped", seq);
+}
+
+static void _reply_state(struct ctrl_client *c, unsigned int seq)
+{
+    _reply(c, "OK %u port=%s state=%s queued=%u", seq, port_opts->name,
+           port_state_str(), opq_count(&opq_rt));
+}
+
+static void _reply_stats(struct ctrl_client *c, unsigned int seq)
+{
+    const struct port_stats_s *st = port_stats();
+
+    if (frame_is_enabled()) {
+        const struct frame_stats_s *fs = frame_stats();
+        _reply(c, "OK %u rx=%zu tx=%zu frames=%zu crc_errors=%zu "
+               "encoding_errors=%zu overruns=%zu", seq, st->rx_bytes,
+               st->tx_bytes, fs->frames, fs->crc_errors, fs->encoding_errors,
+               fs->overruns);
+        return;
+    }
+
+    _reply(c, "OK %u rx=%zu tx=%zu", seq, st->rx_bytes, st->tx_bytes);
+}
+
+static void _on_line(struct ctrl_client *c, char *line)
+{
+    c->seq = (c->seq + 1) & CTRL_SEQ_MASK;
+    unsigned int seq = c->seq;
+
+    line = str_strip(line);
+    if (*line == '\0') {
+        _reply(c, "OK %u", seq);
+        return;
+    }
+
+    if (!strcmp(line, "state")) {
+        _reply_state(c, seq);
+        return;
+    }
+
+    if (!strcmp(line, "stats")) {
+        _reply_stats(c, seq);
+        return;
+    }
+
+    // nothing enqueued if cmd_parse fails or could not notify
+    if (opq_space(&opq_rt) < CMD_OPS_MAX + 1) {
+        _reply(c, "ERR %u EBUSY", seq);
+        return;
+    }
+
+    int err = cmd_parse(CMD_SRC_CTRL, line);
+    if (err) {
+        _reply(c, "ERR %u %s", seq, strerrorname_np(err < 0 ? -err : err));
+        return;
+    }
+
+    int val = (c->id << 16) | seq;
+    err = opq_enqueue_val_cb(&opq_rt, OP_NOTIFY, val, _on_notify);
+    assert(!err); // space checked above
+}
+
+static void _on_data(struct ctrl_client *c, const char *data, size_t size)
+{
+    while (size) {
+        const char *nl = memchr(data, '\n', size);
+        size_t n = nl ? (size_t)(nl - data) : size;
+
+        if (c->len + n >= sizeof(c->line)) {
+            // discard until next newline
+            c->overflow = true;
+            c->len = 0;
+        }
+        else {
+            memcpy(&c->line[c->len], data, n);
+            c->len += n;
+        }
+
+        if (!nl)
+            return;
+
+        c->line[c->len] = '\0';
+        if (c->overflow) {
+            c->seq = (c->seq + 1) & CTRL_SEQ_MASK;
+            _reply(c, "ERR %u E2BIG", c->seq);
+        }
+        else if (c->len) {
+            _on_line(c, c->line);
+        }
+
+        c->overflow = false;
+        c->len = 0;
+        data = nl + 1;
+        size -= n + 1;
+    }
+}
+
+static void _on_client_close(uv_handle_t *handle)
+{
+    free(handle);
+}
+
+static void _client_close(struct ctrl_client *c)
+{
+    struct ctrl_client **pp = &ctrl_data.clients;
+    while (*pp && *pp != c)
+        pp = &(*pp)->next;
+    if (*pp)
+        *pp = c->next;
+
+    // handle is first member, freed in callback
+    uv_close((uv_handle_t *)&c->handle, _on_client_close);
+}
+
+static void _uvcb_alloc(uv_handle_t *handle, size_t size, uv_buf_t *buf)
+{
+    // consumed in read callback
+    static char rdbuf[CTRL_RDBUF_SIZE];
+    buf->base = rdbuf;
+    buf->len = sizeof(rdbuf);
+}
+
+static void _uvcb_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
+{
+    struct ctrl_client *c = (struct ctrl_client *)stream;
+
+    if (nread < 0) {
+        if (nread != UV_EOF)
+            LOG_UV_DBG(nread, "ctrl read");
+
+        _client_close(c);
+        return;
+    }
+
+    _on_data(c, buf->base, nread);
+}
+
+static void _on_connection(uv_stream_t *server, int status)
+{
+    struct ctrl_s *ctrl = &ctrl_data;
+
+    if (status < 0) {
+        LOG_UV_ERR(status, "ctrl connection");
+        return;
+    }
+
+    struct ctrl_client *c = calloc(1, sizeof(*c));
+    assert(c);
+
+    int err = uv_pipe_init(uv_default_loop(), &c->handle, 0);
+    assert_uv_ok(err, "uv_pipe_init");
+
+    err = uv_accept(server, (uv_stream_t *)&c->handle);
+    if (err) {
+        LOG_UV_ERR(err, "ctrl uv_accept");
+        uv_close((uv_handle_t *)&c->handle, _on_client_close);
+        return;
+    }
+
+    ctrl->next_id = (ctrl->next_id % CTRL_ID_MAX) + 1;
+    c->id = ctrl->next_id;
+    c->next = ctrl->clients;
+    ctrl->clients = c;
+
+    err = uv_read_start((uv_stream_t *)&c->handle, _uvcb_alloc, _uvcb_read);
+    if (err) {
+        LOG_UV_ERR(err, "ctrl uv_read_start");
+        _client_close(c);
+        return;
+    }
+
+    LOG_DBG("ctrl client %u connected", c->id);
+}
+
+void ctrl_init(void)
+{
+    struct ctrl_s *ctrl = &ctrl_data;
+    const char *path = ctrl_opts.path;
+    struct stat st;
+
+    if (!path)
+        return;
+
+    // stale socket from previous run
+    if (!stat(path, &st) && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    int err = uv_pipe_init(uv_default_loop(), &ctrl->server, 0);
+    assert_uv_ok(err, "uv_pipe_init");
+
+    err = uv_pipe_bind(&ctrl->server, path);
+    if (!err)
+        err = uv_listen((uv_stream_t *)&ctrl->server, 4, _on_connection);
+
+    if (err) {
+        SPCOM_EXIT(EX_UNAVAILABLE, "ctrl socket '%s' failed, %s", path,
+                   uv_strerror(err));
+    }
+
+    ctrl->initialized = true;
+    LOG_DBG("ctrl socket %s", path);
+}
+
+void ctrl_cleanup(void)
+{
+    struct ctrl_s *ctrl = &ctrl_data;
+
+    if (!ctrl->initialized)
+        return;
+
+    ctrl->initialized = false;
+
+    while (ctrl->clients)
+        _client_close(ctrl->clients);
+
+    uv_close((uv_handle_t *)&ctrl->server, NULL);
+    unlink(ctrl_opts.path);
+}
+
+static const struct opt_conf ctrl_opts_conf[] = {
+    {
+        .name = "ctrl-socket",
+        .dest = &ctrl_opts.path,
+        .parse = opt_parse_str,
+        .metavar = "PATH",
+        .descr = "accept commands on a unix socket, one per line. Each line "
+                 "is answered with 'OK <seq>' when done or 'ERR <seq> <err>'",
+    },
+};
+
+OPT_SECTION_ADD(ctrl,
+                ctrl_opts_conf,
+                ARRAY_LEN(ctrl_opts_conf),
+                NULL);
@@ -0,0 +1,529 @@
+/**
+ * decoding of tokenized logs, i.e. firmware sends a 32 bit token (hash of the
+ * format string) followed by binary arguments instead of formatted text.
+ * Encoding as pigweed pw_tokenizer:
+ *
+ *  - token, 4 bytes little endian
+ *  - integers (`%d %u %x %c %p` ...) zigzag encoded varint
+ *  - floats (`%f %e %g %a`) 4 byte little endian IEEE 754
+ *  - strings (`%s`) 1 byte length (bit 7 set if truncated) and data
+ *
+ * Dictionary loaded at startup from a pw_tokenizer CSV database, i.e. lines of
+ * `token,removal date,"format"`, or a JSON object `{"token": "format", ...}`
+ * with token as hex. Tokens are kept in a open addressing hash table and
+ * messages are formatted into a fixed buffer, i.e. no allocation per message.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "detok.h"
+#include "log.h"
+#include "opt.h"
+
+struct detok_entry {
+    uint32_t token;
+    /// NULL if empty slot
+    const char *fmt;
+};
+
+static struct detok_s {
+    struct detok_entry *table;
+    /// dictionary file content, format strings point into it
+    char *buf;
+    /// power of two
+    size_t size;
+    size_t count;
+    unsigned int shift;
+    /// stats
+    size_t messages;
+    size_t unknown;
+    size_t bytes_in;
+    size_t bytes_out;
+} detok_data;
+
+bool detok_is_enabled(void)
+{
+    return detok_data.count > 0;
+}
+
+static inline size_t _slot(uint32_t token)
+{
+    // fibonacci hashing
+    return (uint32_t)(token * 2654435769u) >> detok_data.shift;
+}
+
+static const char *_lookup(uint32_t token)
+{
+    const struct detok_s *dd = &detok_data;
+    const size_t mask = dd->size - 1;
+
+    for (size_t i = _slot(token);; i = (i + 1) & mask) {
+        const struct detok_entry *e = &dd->table[i];
+        if (!e->fmt)
+            return NULL;
+        if (e->token == token)
+            return e->fmt;
+    }
+}
+
+static void _insert(uint32_t token, const char *fmt)
+{
+    struct detok_s *dd = &detok_data;
+    const size_t mask = dd->size - 1;
+
+    for (size_t i = _slot(token);; i = (i + 1) & mask) {
+        struct detok_entry *e = &dd->table[i];
+        if (!e->fmt) {
+            e->token = token;
+            e->fmt = fmt;
+            dd->count++;
+            return;
+        }
+        // collision in database. keep first
+        if (e->token == token)
+            return;
+    }
+}
+
+/// @return decoded (zigzag) varint or -EINVAL on truncated data
+static int _read_varint(const unsigned char **pp, const unsigned char *end,
+                        int64_t *val)
+{
+    const unsigned char *p = *pp;
+    uint64_t u = 0;
+
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (p >= end)
+            return -EINVAL;
+
+        unsigned char b = *p++;
+        u |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *val = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+            *pp = p;
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+
+/**
+ * format one conversion. `spec` is the conversion without length modifiers.
+ * @return length written or negative on error
+ */
+static int _format_arg(char *dst, size_t size, char *spec, size_t speclen,
+                       char conv, bool is_long, const unsigned char **pp,
+                       const unsigned char *end)
+{
+    int64_t ival;
+    float fval;
+    uint32_t u32;
+    const unsigned char *p = *pp;
+    int rc;
+
+    switch (conv) {
+        case 'd':
+        case 'i':
+        case 'c':
+            if (_read_varint(&p, end, &ival))
+                return -EINVAL;
+            if (conv == 'c') {
+                spec[speclen] = conv;
+                spec[speclen + 1] = '\0';
+                rc = snprintf(dst, size, spec, (int)ival);
+                break;
+            }
+            memcpy(&spec[speclen], "ll", 2);
+            spec[speclen + 2] = conv;
+            spec[speclen + 3] = '\0';
+            rc = snprintf(dst, size, spec,
+                          is_long ? (long long)ival : (long long)(int32_t)ival);
+            break;
+
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'p':
+            if (_read_varint(&p, end, &ival))
+                return -EINVAL;
+            if (conv == 'p') {
+                memcpy(&spec[speclen], "#ll", 3);
+                speclen++;
+                conv = 'x';
+            }
+            else {
+                memcpy(&spec[speclen], "ll", 2);
+            }
+            spec[speclen + 2] = conv;
+            spec[speclen + 3] = '\0';
+            rc = snprintf(dst, size, spec,
+                          is_long ? (unsigned long long)ival
+                                  : (unsigned long long)(uint32_t)ival);
+            break;
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (end - p < 4)
+                return -EINVAL;
+            u32 = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+            memcpy(&fval, &u32, sizeof(fval));
+            p += 4;
+            spec[speclen] = conv;
+            spec[speclen + 1] = '\0';
+            rc = snprintf(dst, size, spec, (double)fval);
+            break;
+
+        case 's': {
+            if (p >= end)
+                return -EINVAL;
+            int len = *p & 0x7f;
+            bool truncated = *p & 0x80;
+            p++;
+            if (end - p < len)
+                return -EINVAL;
+            // string not null terminated
+            rc = snprintf(dst, size, "%.*s%s", len, (const char *)p,
+                          truncated ? "[...]" : "");
+            p += len;
+            break;
+        }
+
+        default:
+            return -EINVAL;
+    }
+
+    *pp = p;
+    return rc;
+}
+
+int detok_decode(const void *data, size_t size, char *dst, size_t dstsize)
+{
+    struct detok_s *dd = &detok_data;
+    const unsigned char *p = data;
+    const unsigned char *end = p + size;
+    size_t len = 0;
+
+    assert(dstsize > 0);
+
+    if (size < 4)
+        return -EINVAL;
+
+    uint32_t token = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    p += 4;
+
+    dd->messages++;
+    dd->bytes_in += size;
+
+    const char *fmt = _lookup(token);
+    if (!fmt) {
+        dd->unknown++;
+        return snprintf(dst, dstsize, "<unknown token %08x>", token);
+    }
+
+    while (*fmt && len < dstsize - 1) {
+        if (*fmt != '%') {
+            dst[len++] = *fmt++;
+            continue;
+        }
+
+        if (fmt[1] == '%') {
+            dst[len++] = '%';
+            fmt += 2;
+            continue;
+        }
+
+        // flags, width and precision copied. length modifiers replaced
+        char spec[32];
+        size_t speclen = 0;
+        spec[speclen++] = *fmt++;
+        while (*fmt && strchr("-+ #0123456789.", *fmt) && speclen < 24)
+            spec[speclen++] = *fmt++;
+
+        bool is_long = false;
+        while (*fmt && strchr("hlLjzt", *fmt)) {
+            if (*fmt == 'j' || (*fmt == 'l' && fmt[1] == 'l'))
+                is_long = true;
+            fmt++;
+        }
+
+        char conv = *fmt;
+        if (!conv)
+            break;
+        fmt++;
+
+        int rc = _format_arg(&dst[len], dstsize - len, spec, speclen, conv,
+                             is_long, &p, end);
+        if (rc < 0) {
+            rc = snprintf(&dst[len], dstsize - len, "<bad arg>");
+            fmt = "";
+        }
+
+        len += rc;
+        if (len >= dstsize)
+            len = dstsize - 1;
+    }
+
+    dst[len] = '\0';
+    dd->bytes_out += len;
+
+    return len;
+}
+
+static void _table_alloc(size_t n)
+{
+    struct detok_s *dd = &detok_data;
+
+    dd->size = 16;
+    dd->shift = 32 - 4;
+    // load factor at most 0.5
+    while (dd->size < 2 * n) {
+        dd->size *= 2;
+        dd->shift--;
+    }
+
+    dd->table = calloc(dd->size, sizeof(*dd->table));
+    assert(dd->table);
+}
+
+/// parse quoted string in place. @return pointer after closing quote
+static char *_parse_quoted(char *s, char **out, bool json)
+{
+    char *d = s;
+
+    if (*s++ != '"')
+        return NULL;
+
+    *out = d;
+    while (*s) {
+        char c = *s++;
+        if (c == '"') {
+            // csv escapes quote by doubling it
+            if (!json && *s == '"') {
+                *d++ = *s++;
+                continue;
+            }
+            *d = '\0';
+            return s;
+        }
+        if (json && c == '\\') {
+            c = *s++;
+            switch (c) {
+                case 'n':
+                    c = '\n';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                case 'b':
+                    c = '\b';
+                    break;
+                case 'f':
+                    c = '\f';
+                    break;
+                case 'u': {
+                    unsigned int cp = 0;
+                    // exactly 4 hex digits, i.e. not past end if truncated
+                    for (int i = 0; i < 4; i++, s++) {
+                        if (!isxdigit((unsigned char)*s))
+                            return NULL;
+                        cp = (cp << 4) | (isdigit((unsigned char)*s)
+                                              ? *s - '0'
+                                              : (tolower(*s) - 'a' + 10));
+                    }
+                    c = (cp < 0x80) ? cp : '?';
+                    break;
+                }
+                case '\0':
+                    return NULL;
+                default:
+                    // `"`, `\` and `/`
+                    break;
+            }
+        }
+        *d++ = c;
+    }
+
+    return NULL;
+}
+
+static char *_skip_space(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    return s;
+}
+
+/// count upper bound of entries, for table size
+static size_t _count_lines(const char *s)
+{
+    size_t n = 1;
+
+    for (; *s; s++)
+        n += (*s == '\n' || *s == ',');
+
+    return n;
+}
+
+static int _load_json(char *s)
+{
+    s = _skip_space(s);
+    if (*s++ != '{')
+        return -EINVAL;
+
+    while (1) {
+        char *key;
+        char *fmt;
+
+        s = _skip_space(s);
+        if (*s == '}')
+            return 0;
+
+        s = _parse_quoted(s, &key, true);
+        if (!s)
+            return -EINVAL;
+
+        s = _skip_space(s);
+        if (*s++ != ':')
+            return -EINVAL;
+
+        s = _skip_space(s);
+        s = _parse_quoted(s, &fmt, true);
+        if (!s)
+            return -EINVAL;
+
+        char *ep;
+        errno = 0;
+        unsigned long token = strtoul(key, &ep, 16);
+        if (errno || *ep != '\0' || token > UINT32_MAX)
+            return -EINVAL;
+
+        _insert(token, fmt);
+
+        s = _skip_space(s);
+        if (*s == ',')
+            s++;
+        else if (*s != '}')
+            return -EINVAL;
+    }
+}
+
+static int _load_csv(char *s)
+{
+    int lineno = 0;
+
+    while (*s) {
+        char *fmt;
+
+        lineno++;
+        s = _skip_space(s);
+        if (*s == '\0')
+            break;
+
+        char *ep;
+        unsigned long token = strtoul(s, &ep, 16);
+        if (ep == s || *ep != ',')
+            return lineno;
+
+        // removal date ignored
+        s = strchr(ep + 1, ',');
+        if (!s)
+            return lineno;
+
+        s = _parse_quoted(_skip_space(s + 1), &fmt, false);
+        if (!s)
+            return lineno;
+
+        _insert(token, fmt);
+
+        s = strchr(s, '\n');
+        if (!s)
+            break;
+        s++;
+    }
+
+    return 0;
+}
+
+static int _parse_cb_detok(const struct opt_conf *conf, char *sval)
+{
+    struct detok_s *dd = &detok_data;
+
+    if (dd->table)
+        return opt_perror(conf, "only one dictionary supported");
+
+    FILE *fp = fopen(sval, "r");
+    if (!fp)
+        return opt_perror(conf, "%s '%s'", strerror(errno), sval);
+
+    char *buf = NULL;
+    size_t bufsize = 0;
+    ssize_t len = getdelim(&buf, &bufsize, '\0', fp);
+    fclose(fp);
+
+    if (len <= 0) {
+        free(buf);
+        return opt_perror(conf, "empty dictionary '%s'", sval);
+    }
+
+    dd->buf = buf;
+    _table_alloc(_count_lines(buf));
+
+    char *s = _skip_space(buf);
+    int err = (*s == '{') ? _load_json(s) : _load_csv(s);
+    if (err || !dd->count)
+        return opt_perror(conf, "invalid dictionary '%s' (%d)", sval, err);
+
+    return 0;
+}
+
+void detok_cleanup(void)
+{
+    struct detok_s *dd = &detok_data;
+
+    free(dd->table);
+    dd->table = NULL;
+    free(dd->buf);
+    dd->buf = NULL;
+    dd->count = 0;
+
+    if (!dd->messages)
+        return;
+
+    LOG_INF("detok %zu messages (%zu unknown), %zu bytes received, "
+            "%zu bytes text, %.1fx",
+            dd->messages, dd->unknown, dd->bytes_in, dd->bytes_out,
+            (double)dd->bytes_out / dd->bytes_in);
+}
+
+static const struct opt_conf detok_opts_conf[] = {
+    {
+        .name = "detok",
+        .parse = _parse_cb_detok,
+        .metavar = "FILE",
+        .descr = "decode tokenized log frames (see --frame) with token "
+                 "dictionary. pw_tokenizer CSV database or JSON object",
+    },
+};
+
+OPT_SECTION_ADD(detok,
+                detok_opts_conf,
+                ARRAY_LEN(detok_opts_conf),
+                NULL);
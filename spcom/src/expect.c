@@ -0,0 +1,218 @@
+/**
+ * expect - hold the operation queue until a pattern is received on port.
+ *
+ * A OP_EXPECT item is handled by port.c as a blocking operation, like sleep.
+ * Operations enqueued after it (send, sleep, rts, exit etc.) act as the
+ * actions on match. On timeout spcom exits with the exit code of the item.
+ *
+ * Received data is matched incrementally as it passes through the port
+ * receive path, see rematch.h. Data received after a match in the same chunk
+ * is kept and fed to the next expect, if that is the very next operation.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+// deps
+#include <uv.h>
+// local
+#include "assert.h"
+#include "capture.h"
+#include "common.h"
+#include "expect.h"
+#include "log.h"
+#include "opq.h"
+#include "opt.h"
+#include "rematch.h"
+
+#define EXPECT_CARRY_SIZE 1024
+
+struct expect_item {
+    struct rematch re;
+    /// negative for default
+    int timeout_ms;
+    int exit_code;
+    char pattern[];
+};
+
+static struct expect_opts_s {
+    float timeout;
+} expect_opts = {
+    .timeout = EXPECT_TIMEOUT_DEFAULT,
+};
+
+static struct expect_s {
+    bool timer_initialized;
+    uv_timer_t timer;
+    struct expect_item *active;
+    expect_done_fn *done_cb;
+    /// received after last match, not yet matched
+    size_t carry_len;
+    char carry[EXPECT_CARRY_SIZE];
+} expect_data;
+
+static void _expect_free(const struct opq_item *itm)
+{
+    struct expect_s *e = &expect_data;
+    struct expect_item *ei = itm->u.data;
+
+    // i.e. queue released on port close
+    if (e->active == ei) {
+        e->active = NULL;
+        uv_timer_stop(&e->timer);
+    }
+
+    free(ei);
+}
+
+int expect_enqueue(struct opq *q, const char *pattern, bool literal,
+                   int timeout_ms, int exit_code)
+{
+    size_t len = strlen(pattern);
+    struct expect_item *ei = malloc(sizeof(*ei) + len + 1);
+    assert(ei);
+
+    int err = rematch_compile(&ei->re, pattern, literal);
+    if (err) {
+        LOG_ERR("invalid expect pattern '%s'", pattern);
+        free(ei);
+        return err;
+    }
+
+    ei->timeout_ms = timeout_ms;
+    ei->exit_code = exit_code;
+    memcpy(ei->pattern, pattern, len + 1);
+
+    struct opq_item *itm = opq_acquire_tail(q);
+    if (!itm) {
+        free(ei);
+        return -ENOBUFS;
+    }
+
+    itm->op_code = OP_EXPECT;
+    itm->size = sizeof(*ei);
+    itm->u.data = ei;
+    itm->free_cb = _expect_free;
+
+    return opq_enqueue_tail(q, itm);
+}
+
+static void _on_timeout(uv_timer_t *handle)
+{
+    struct expect_item *ei = expect_data.active;
+    assert(ei);
+
+    capture_event(CAPTURE_TAG_EVT, "expect timeout '%s'", ei->pattern);
+    SPCOM_EXIT(ei->exit_code, "expect timeout '%s'", ei->pattern);
+}
+
+/// @return true if matched. carry updated with data after match
+static bool _match(const char *data, size_t size)
+{
+    struct expect_s *e = &expect_data;
+    struct expect_item *ei = e->active;
+
+    size_t n = rematch_feed(&ei->re, data, size);
+    if (!n)
+        return false;
+
+    size_t rest = size - n;
+    if (rest > sizeof(e->carry))
+        rest = sizeof(e->carry);
+    // might overlap when matching from carry
+    memmove(e->carry, data + n, rest);
+    e->carry_len = rest;
+
+    LOG_DBG("expect '%s' matched", ei->pattern);
+    capture_event(CAPTURE_TAG_EVT, "expect matched '%s'", ei->pattern);
+
+    uv_timer_stop(&e->timer);
+    e->active = NULL;
+    // item freed by this
+    e->done_cb();
+
+    return true;
+}
+
+void expect_start(void *data, expect_done_fn *done_cb)
+{
+    struct expect_s *e = &expect_data;
+    struct expect_item *ei = data;
+    int err;
+
+    assert(!e->active);
+    assert(done_cb);
+
+    rematch_reset(&ei->re);
+    e->active = ei;
+    e->done_cb = done_cb;
+
+    if (e->carry_len) {
+        size_t n = e->carry_len;
+        e->carry_len = 0;
+        if (_match(e->carry, n))
+            return;
+    }
+
+    if (!e->timer_initialized) {
+        err = uv_timer_init(uv_default_loop(), &e->timer);
+        assert_uv_ok(err, "uv_timer_init");
+        e->timer_initialized = true;
+    }
+
+    int ms = ei->timeout_ms;
+    if (ms < 0)
+        ms = expect_opts.timeout * 1000;
+
+    if (ms > 0) {
+        err = uv_timer_start(&e->timer, _on_timeout, ms, 0);
+        assert_uv_ok(err, "uv_timer_start");
+    }
+
+    LOG_DBG("expecting '%s'", ei->pattern);
+}
+
+void expect_feed(const void *data, size_t size)
+{
+    struct expect_s *e = &expect_data;
+
+    if (!e->active) {
+        // not followed by a expect. do not match old data later
+        e->carry_len = 0;
+        return;
+    }
+
+    _match(data, size);
+}
+
+static int _parse_cb_expect(const struct opt_conf *conf, char *sval)
+{
+    int err = expect_enqueue(&opq_oo, sval, true, -1, EXPECT_EXIT_CODE);
+    if (err)
+        return opt_perror(conf, "invalid pattern");
+
+    return 0;
+}
+
+static const struct opt_conf expect_opts_conf[] = {
+    {
+        .name = "expect",
+        .parse = _parse_cb_expect,
+        .metavar = "STRING",
+        .descr = "wait for STRING to be received before any following --cmd "
+                 "or --expect. Exit on timeout",
+    },
+    {
+        .name = "expect-timeout",
+        .dest = &expect_opts.timeout,
+        .parse = opt_parse_float,
+        .metavar = "SECONDS",
+        .descr = "default expect timeout. Zero waits forever. "
+                 "Default " STRINGIFY(EXPECT_TIMEOUT_DEFAULT),
+    },
+};
+
+OPT_SECTION_ADD(expect,
+                expect_opts_conf,
+                ARRAY_LEN(expect_opts_conf),
+                NULL);
@@ -0,0 +1,651 @@
+/**
+ * packet framing decoders for received data. Frames are decoded incrementally,
+ * i.e. can span any number of chunks, and each frame is shown as one record:
+ *
+ *     <timestamp>frame <num> len <len> <status>: <payload as hex or text>
+ *
+ * and written to capture file, if enabled. Supported framing:
+ *  - `slip`  RFC 1055
+ *  - `cobs`  consistent overhead byte stuffing, zero delimited
+ *  - `hdlc`  asynchronous HDLC-like framing, RFC 1662
+ *  - `len8`, `len16le`, `len16be` length prefixed. length excludes prefix
+ *  - `gap`   idle time between bytes, e.g. Modbus RTU. Gap given with
+ *            `--frame-gap` or 3.5 character times from port settings
+ *
+ * Optional CRC at end of frame (least significant byte first), verified with
+ * slice-by-8 kernels in crc.c. HDLC uses FCS-16 by default.
+ *
+ * With `--detok`, good frames are decoded as tokenized log messages and shown
+ * as text lines through outfmt instead.
+ *
+ * Gaps are measured between read timestamps (port_stats), not per byte, so
+ * accuracy depends on reads being done promptly. Timer is only used to end
+ * the last frame when line goes idle.
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+// deps
+#include <uv.h>
+// local
+#include "assert.h"
+#include "capture.h"
+#include "common.h"
+#include "crc.h"
+#include "ctohex.h"
+#include "detok.h"
+#include "frame.h"
+#include "highlight.h"
+#include "jsonl.h"
+#include "log.h"
+#include "opt.h"
+#include "outfmt.h"
+#include "port.h"
+#include "port_opts.h"
+#include "shell.h"
+#include "str.h"
+#include "trace.h"
+#include "strto.h"
+
+#define FRAME_MAX_DEFAULT 4096
+
+#define SLIP_END 0xc0
+#define SLIP_ESC 0xdb
+#define SLIP_ESC_END 0xdc
+#define SLIP_ESC_ESC 0xdd
+
+#define HDLC_FLAG 0x7e
+#define HDLC_ESC 0x7d
+#define HDLC_XOR 0x20
+
+enum frame_type {
+    FRAME_NONE = 0,
+    FRAME_SLIP,
+    FRAME_COBS,
+    FRAME_HDLC,
+    FRAME_LEN8,
+    FRAME_LEN16LE,
+    FRAME_LEN16BE,
+    FRAME_GAP,
+};
+
+enum frame_crc {
+    FRAME_CRC_DEFAULT = 0,
+    FRAME_CRC_NONE,
+    FRAME_CRC16,
+    FRAME_CRC32,
+    FRAME_CRC16_MODBUS,
+};
+
+enum frame_status {
+    FRAME_OK = 0,
+    FRAME_ERR_CRC,
+    FRAME_ERR_ENCODING,
+    FRAME_ERR_OVERRUN,
+};
+
+static const char *frame_status_str[] = {
+    [FRAME_OK] = "ok",
+    [FRAME_ERR_CRC] = "crc-error",
+    [FRAME_ERR_ENCODING] = "bad-encoding",
+    [FRAME_ERR_OVERRUN] = "overrun",
+};
+
+static struct frame_opts_s {
+    int type;
+    int crc;
+    int max;
+    int text;
+    int gap_us;
+} frame_opts = {
+    .max = FRAME_MAX_DEFAULT,
+};
+
+static struct frame_s {
+    /// decoded frame, including crc
+    unsigned char *buf;
+    size_t len;
+    size_t bufsize;
+    int crc;
+    /// crc size in bytes
+    unsigned int crc_size;
+    bool esc;
+    bool bad;
+    bool overrun;
+    /// cobs code and data bytes left in block
+    unsigned int cobs_code;
+    unsigned int cobs_left;
+    /// length prefix
+    unsigned char hdr[2];
+    unsigned int hdr_len;
+    unsigned int hdr_size;
+    size_t need;
+    /// idle gap
+    uint64_t gap_ns;
+    uint64_t t_last;
+    uv_timer_t gap_timer;
+    /// display record
+    char *line;
+    size_t linesize;
+    struct frame_stats_s stats;
+    uint64_t t_start;
+} frame_data;
+
+bool frame_is_enabled(void)
+{
+    return frame_opts.type != FRAME_NONE;
+}
+
+const struct frame_stats_s *frame_stats(void)
+{
+    return &frame_data.stats;
+}
+
+static void _reset(void)
+{
+    struct frame_s *fd = &frame_data;
+
+    fd->len = 0;
+    fd->esc = false;
+    fd->bad = false;
+    fd->overrun = false;
+    fd->cobs_code = 0;
+    fd->cobs_left = 0;
+    fd->hdr_len = 0;
+    fd->need = 0;
+}
+
+static inline void _putb(unsigned char b)
+{
+    struct frame_s *fd = &frame_data;
+
+    if (fd->len < fd->bufsize)
+        fd->buf[fd->len++] = b;
+    else
+        fd->overrun = true;
+}
+
+static bool _crc_ok(const unsigned char *p, size_t len)
+{
+    const struct frame_s *fd = &frame_data;
+    const unsigned char *c = &p[len];
+
+    if (fd->crc == FRAME_CRC16)
+        return crc16_x25(p, len) == (c[0] | c[1] << 8);
+
+    if (fd->crc == FRAME_CRC16_MODBUS)
+        return crc16_modbus(p, len) == (c[0] | c[1] << 8);
+
+    uint32_t crc = c[0] | c[1] << 8 | c[2] << 16 | (uint32_t)c[3] << 24;
+    return crc32_ieee(p, len) == crc;
+}
+
+static void _display(enum frame_status status, const unsigned char *p,
+                     size_t len)
+{
+    struct frame_s *fd = &frame_data;
+    char *d = fd->line;
+
+    if (jsonl_is_enabled()) {
+        jsonl_frame(fd->stats.frames, frame_status_str[status], p, len);
+        return;
+    }
+
+    int rc = str_iso8601_short(d, fd->linesize);
+    if (rc > 0)
+        d += rc;
+
+    d += sprintf(d, "frame %zu len %zu %s: ", fd->stats.frames, len,
+                 frame_status_str[status]);
+
+    if (frame_opts.text) {
+        size_t remains = fd->linesize - (d - fd->line) - 1;
+        d += str_escape_nonprint(d, remains, (const char *)p, len);
+    }
+    else {
+        for (size_t i = 0; i < len; i++) {
+            memcpy(d, &ctohex_pairs[2 * p[i]], 2);
+            d[2] = ' ';
+            d += 3;
+        }
+        // no trailing space
+        if (len)
+            d--;
+    }
+
+    *d++ = '\n';
+    shell_write(STDOUT_FILENO, fd->line, d - fd->line);
+}
+
+/// decoded text passed on as received lines, i.e. filters etc. applies
+static void _display_detok(const unsigned char *p, size_t len)
+{
+    struct frame_s *fd = &frame_data;
+
+    int n = detok_decode(p, len, fd->line, fd->linesize - 1);
+    if (n < 0) {
+        _display(FRAME_ERR_ENCODING, p, len);
+        return;
+    }
+
+    fd->line[n++] = '\n';
+    highlight_feed(fd->line, n);
+    outfmt_write(fd->line, n);
+}
+
+/// end of frame
+static void _emit(void)
+{
+    struct frame_s *fd = &frame_data;
+    struct frame_stats_s *st = &fd->stats;
+    enum frame_status status = FRAME_OK;
+    size_t len = fd->len;
+
+    if (fd->overrun) {
+        status = FRAME_ERR_OVERRUN;
+    }
+    else if (fd->bad) {
+        status = FRAME_ERR_ENCODING;
+    }
+    else if (fd->crc_size) {
+        if (len < fd->crc_size) {
+            status = FRAME_ERR_ENCODING;
+        }
+        else {
+            len -= fd->crc_size;
+            if (!_crc_ok(fd->buf, len))
+                status = FRAME_ERR_CRC;
+        }
+    }
+
+    st->frames++;
+    st->bytes += len;
+    switch (status) {
+        case FRAME_ERR_CRC:
+            st->crc_errors++;
+            break;
+        case FRAME_ERR_ENCODING:
+            st->encoding_errors++;
+            break;
+        case FRAME_ERR_OVERRUN:
+            st->overruns++;
+            break;
+        default:
+            break;
+    }
+
+    if (status == FRAME_OK && detok_is_enabled())
+        _display_detok(fd->buf, len);
+    else
+        _display(status, fd->buf, len);
+
+    if (status == FRAME_OK)
+        capture_data(CAPTURE_TAG_FRAME, fd->buf, len);
+    else
+        capture_event(CAPTURE_TAG_EVT, "frame %zu %s len %zu", st->frames,
+                      frame_status_str[status], len);
+
+    _reset();
+}
+
+static void _feed_slip(unsigned char b)
+{
+    struct frame_s *fd = &frame_data;
+
+    if (b == SLIP_END) {
+        // empty frames are used to flush line noise
+        if (fd->len || fd->bad || fd->overrun)
+            _emit();
+        return;
+    }
+
+    if (fd->esc) {
+        fd->esc = false;
+        if (b == SLIP_ESC_END)
+            b = SLIP_END;
+        else if (b == SLIP_ESC_ESC)
+            b = SLIP_ESC;
+        else
+            fd->bad = true;
+    }
+    else if (b == SLIP_ESC) {
+        fd->esc = true;
+        return;
+    }
+
+    _putb(b);
+}
+
+static void _feed_hdlc(unsigned char b)
+{
+    struct frame_s *fd = &frame_data;
+
+    if (b == HDLC_FLAG) {
+        if (fd->esc) {
+            // abort sequence
+            fd->stats.encoding_errors++;
+            _reset();
+            return;
+        }
+        if (fd->len || fd->bad || fd->overrun)
+            _emit();
+        return;
+    }
+
+    if (fd->esc) {
+        fd->esc = false;
+        b ^= HDLC_XOR;
+    }
+    else if (b == HDLC_ESC) {
+        fd->esc = true;
+        return;
+    }
+
+    _putb(b);
+}
+
+static void _feed_cobs(unsigned char b)
+{
+    struct frame_s *fd = &frame_data;
+
+    if (b == 0) {
+        // truncated block
+        if (fd->cobs_left)
+            fd->bad = true;
+        if (fd->len || fd->bad || fd->overrun)
+            _emit();
+        else
+            _reset();
+        return;
+    }
+
+    if (fd->cobs_left) {
+        _putb(b);
+        fd->cobs_left--;
+        return;
+    }
+
+    // code byte. implicit zero after previous block, unless max size block
+    if (fd->cobs_code && fd->cobs_code != 0xff)
+        _putb(0);
+
+    fd->cobs_code = b;
+    fd->cobs_left = b - 1;
+}
+
+static void _feed_len(unsigned char b)
+{
+    struct frame_s *fd = &frame_data;
+
+    if (fd->hdr_len < fd->hdr_size) {
+        fd->hdr[fd->hdr_len++] = b;
+        if (fd->hdr_len < fd->hdr_size)
+            return;
+
+        switch (frame_opts.type) {
+            case FRAME_LEN8:
+                fd->need = fd->hdr[0];
+                break;
+            case FRAME_LEN16LE:
+                fd->need = fd->hdr[0] | fd->hdr[1] << 8;
+                break;
+            case FRAME_LEN16BE:
+                fd->need = fd->hdr[0] << 8 | fd->hdr[1];
+                break;
+        }
+
+        if (!fd->need)
+            _emit();
+        return;
+    }
+
+    _putb(b);
+    if (--fd->need == 0)
+        _emit();
+}
+
+static void _on_gap_timeout(uv_timer_t *handle)
+{
+    TRACE(TRACE_TIMER, TRACE_TIMER_FRAME_GAP);
+    struct frame_s *fd = &frame_data;
+
+    if (fd->len || fd->overrun)
+        _emit();
+}
+
+static void _feed_gap(const unsigned char *p, size_t size)
+{
+    struct frame_s *fd = &frame_data;
+    uint64_t t = port_stats()->rx_time;
+
+    if (!t)
+        t = uv_hrtime();
+
+    if ((fd->len || fd->overrun) && t - fd->t_last > fd->gap_ns)
+        _emit();
+
+    fd->t_last = t;
+
+    for (size_t i = 0; i < size; i++)
+        _putb(p[i]);
+
+    // ms resolution. rounded up, so never before gap
+    uint64_t ms = (fd->gap_ns + 999999) / 1000000;
+    int err = uv_timer_start(&fd->gap_timer, _on_gap_timeout, ms, 0);
+    assert_uv_ok(err, "uv_timer_start");
+}
+
+void frame_feed(const void *data, size_t size)
+{
+    const unsigned char *p = data;
+
+    switch (frame_opts.type) {
+        case FRAME_SLIP:
+            for (size_t i = 0; i < size; i++)
+                _feed_slip(p[i]);
+            break;
+        case FRAME_COBS:
+            for (size_t i = 0; i < size; i++)
+                _feed_cobs(p[i]);
+            break;
+        case FRAME_HDLC:
+            for (size_t i = 0; i < size; i++)
+                _feed_hdlc(p[i]);
+            break;
+        case FRAME_LEN8:
+        case FRAME_LEN16LE:
+        case FRAME_LEN16BE:
+            for (size_t i = 0; i < size; i++)
+                _feed_len(p[i]);
+            break;
+        case FRAME_GAP:
+            _feed_gap(p, size);
+            break;
+        default:
+            break;
+    }
+}
+
+/// 3.5 character times, as Modbus RTU, unless given
+static void _gap_init(void)
+{
+    struct frame_s *fd = &frame_data;
+    const struct port_opts_s *po = port_opts;
+
+    if (frame_opts.gap_us > 0) {
+        fd->gap_ns = frame_opts.gap_us * 1000ULL;
+    }
+    else {
+        if (po->baudrate <= 0)
+            SPCOM_EXIT(EX_USAGE, "--frame gap needs baudrate or --frame-gap");
+
+        // start bit + data + parity + stop
+        int bits = 1 + (po->databits > 0 ? po->databits : 8)
+                   + (po->parity > 0 ? 1 : 0)
+                   + (po->stopbits > 0 ? po->stopbits : 1);
+
+        fd->gap_ns = 3.5 * bits * 1e9 / po->baudrate;
+    }
+
+    int err = uv_timer_init(uv_default_loop(), &fd->gap_timer);
+    assert_uv_ok(err, "uv_timer_init");
+
+    LOG_DBG("frame gap %" PRIu64 " us", fd->gap_ns / 1000);
+}
+
+void frame_init(void)
+{
+    struct frame_s *fd = &frame_data;
+
+    if (!frame_is_enabled()) {
+        if (detok_is_enabled())
+            SPCOM_EXIT(EX_USAGE, "--detok requires --frame");
+        return;
+    }
+
+    int crc = frame_opts.crc;
+    if (crc == FRAME_CRC_DEFAULT)
+        crc = (frame_opts.type == FRAME_HDLC) ? FRAME_CRC16 : FRAME_CRC_NONE;
+
+    fd->crc = crc;
+    fd->crc_size = (crc == FRAME_CRC32) ? 4 : (crc == FRAME_CRC_NONE) ? 0 : 2;
+    fd->hdr_size = (frame_opts.type == FRAME_LEN8) ? 1 : 2;
+
+    fd->bufsize = frame_opts.max + fd->crc_size;
+    fd->buf = malloc(fd->bufsize);
+    // timestamp, header and payload as hex or escaped text
+    fd->linesize = STR_ISO8601_SHORT_SIZE + 64 + fd->bufsize * 5;
+    fd->line = malloc(fd->linesize);
+    assert(fd->buf && fd->line);
+
+    if (frame_opts.type == FRAME_GAP)
+        _gap_init();
+
+    fd->t_start = uv_hrtime();
+    _reset();
+}
+
+void frame_cleanup(void)
+{
+    struct frame_s *fd = &frame_data;
+    const struct frame_stats_s *st = &fd->stats;
+
+    if (!frame_is_enabled())
+        return;
+
+    double sec = (uv_hrtime() - fd->t_start) / 1e9;
+    LOG_INF("frames %zu (%.1f/s), bytes %zu, crc errors %zu, "
+            "encoding errors %zu, overruns %zu",
+            st->frames, sec > 0 ? st->frames / sec : 0.0, st->bytes,
+            st->crc_errors, st->encoding_errors, st->overruns);
+
+    free(fd->buf);
+    fd->buf = NULL;
+    free(fd->line);
+    fd->line = NULL;
+}
+
+static int _parse_cb_type(const struct opt_conf *conf, char *sval)
+{
+    static const char *names[] = {
+        [FRAME_SLIP] = "slip",       [FRAME_COBS] = "cobs",
+        [FRAME_HDLC] = "hdlc",       [FRAME_LEN8] = "len8",
+        [FRAME_LEN16LE] = "len16le", [FRAME_LEN16BE] = "len16be",
+        [FRAME_GAP] = "gap",
+    };
+
+    for (int i = FRAME_SLIP; i < ARRAY_LEN(names); i++) {
+        if (!strcmp(sval, names[i])) {
+            frame_opts.type = i;
+            return 0;
+        }
+    }
+
+    return opt_perror(conf, "unknown framing '%s'", sval);
+}
+
+static int _parse_cb_crc(const struct opt_conf *conf, char *sval)
+{
+    if (!strcmp(sval, "none"))
+        frame_opts.crc = FRAME_CRC_NONE;
+    else if (!strcmp(sval, "crc16"))
+        frame_opts.crc = FRAME_CRC16;
+    else if (!strcmp(sval, "crc32"))
+        frame_opts.crc = FRAME_CRC32;
+    else if (!strcmp(sval, "modbus"))
+        frame_opts.crc = FRAME_CRC16_MODBUS;
+    else
+        return opt_perror(conf, "expected none, crc16, crc32 or modbus");
+
+    return 0;
+}
+
+static int _parse_cb_max(const struct opt_conf *conf, char *sval)
+{
+    int max;
+    int err = strto_i(sval, NULL, 0, &max);
+    if (err || max < 1)
+        return opt_perror(conf, "invalid size");
+
+    frame_opts.max = max;
+    return 0;
+}
+
+static int _parse_cb_gap(const struct opt_conf *conf, char *sval)
+{
+    int us;
+    int err = strto_i(sval, NULL, 0, &us);
+    if (err || us < 1)
+        return opt_perror(conf, "invalid gap");
+
+    frame_opts.gap_us = us;
+    return 0;
+}
+
+static const struct opt_conf frame_opts_conf[] = {
+    {
+        .name = "frame",
+        .parse = _parse_cb_type,
+        .metavar = "TYPE",
+        .descr = "decode received data as frames and show one record per "
+                 "frame. TYPE: slip, cobs, hdlc, len8, len16le, len16be "
+                 "or gap",
+    },
+    {
+        .name = "frame-crc",
+        .parse = _parse_cb_crc,
+        .metavar = "CRC",
+        .descr = "CRC at end of frame: none, crc16 (X.25), crc32 or modbus. "
+                 "Default crc16 for hdlc, otherwise none",
+    },
+    {
+        .name = "frame-max",
+        .parse = _parse_cb_max,
+        .metavar = "BYTES",
+        .descr = "max frame payload size. Default: "
+                 STRINGIFY(FRAME_MAX_DEFAULT),
+    },
+    {
+        .name = "frame-gap",
+        .parse = _parse_cb_gap,
+        .metavar = "USEC",
+        .descr = "idle time in microseconds that ends a frame with "
+                 "`--frame gap`. Default: 3.5 character times",
+    },
+    {
+        .name = "frame-text",
+        .dest = &frame_opts.text,
+        .parse = opt_parse_flag_true,
+        .descr = "show frame payload as text instead of hex",
+    },
+};
+
+OPT_SECTION_ADD(frame,
+                frame_opts_conf,
+                ARRAY_LEN(frame_opts_conf),
+                NULL);
@@ -0,0 +1,260 @@
+/**
+ * hexdump display of received data, similar to `hexdump -C`:
+ *
+ *     00000010  48 65 6c 6c 6f 20 77 6f  72 6c 64 0d 0a 00 01 02  |Hello world.....|
+ *
+ * Rows are formatted directly into a output buffer using the hex pairs in
+ * ctohex.c, i.e. no printf per byte. A partial row is kept until the row is
+ * complete, or written as is after HEXDUMP_IDLE_MS without data.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+// deps
+#include <uv.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "ctohex.h"
+#include "hexdump.h"
+#include "log.h"
+#include "opt.h"
+#include "shell.h"
+#include "str.h"
+#include "strto.h"
+#include "trace.h"
+
+#define HEXDUMP_WIDTH_DEFAULT 16
+#define HEXDUMP_WIDTH_MAX 64
+#define HEXDUMP_IDLE_MS 50
+#define HEXDUMP_OBUF_SIZE (64 * 1024)
+
+/// upper bound of formatted row size
+#define HEXDUMP_ROW_SIZE_MAX                                                   \
+    (STR_ISO8601_SHORT_SIZE + 10 + HEXDUMP_WIDTH_MAX * 4                       \
+     + HEXDUMP_WIDTH_MAX / 8 + 4)
+
+static struct hexdump_opts_s {
+    int enable;
+    int width;
+    int no_offset;
+    int no_ascii;
+} hexdump_opts = {
+    .width = HEXDUMP_WIDTH_DEFAULT,
+};
+
+static struct hexdump_s {
+    bool initialized;
+    /// pending bytes of incomplete row
+    unsigned char row[HEXDUMP_WIDTH_MAX];
+    unsigned int nrow;
+    /// offset of first byte in next row
+    uint64_t offset;
+    char ts[STR_ISO8601_SHORT_SIZE];
+    int tslen;
+    uv_timer_t timer;
+    size_t olen;
+    char obuf[HEXDUMP_OBUF_SIZE];
+} hexdump_data;
+
+bool hexdump_is_enabled(void)
+{
+    return hexdump_opts.enable;
+}
+
+static void _obuf_flush(void)
+{
+    struct hexdump_s *hd = &hexdump_data;
+
+    if (!hd->olen)
+        return;
+
+    shell_write(STDOUT_FILENO, hd->obuf, hd->olen);
+    hd->olen = 0;
+}
+
+static inline char *_put_pair(char *d, unsigned char b)
+{
+    memcpy(d, &ctohex_pairs[2 * b], 2);
+    return d + 2;
+}
+
+static void _row_format(const unsigned char *p, unsigned int n)
+{
+    struct hexdump_s *hd = &hexdump_data;
+    const unsigned int width = hexdump_opts.width;
+
+    if (hd->olen + HEXDUMP_ROW_SIZE_MAX > sizeof(hd->obuf))
+        _obuf_flush();
+
+    char *d = &hd->obuf[hd->olen];
+
+    if (hd->tslen) {
+        memcpy(d, hd->ts, hd->tslen);
+        d += hd->tslen;
+    }
+
+    if (!hexdump_opts.no_offset) {
+        uint32_t offs = hd->offset;
+        d = _put_pair(d, offs >> 24);
+        d = _put_pair(d, offs >> 16);
+        d = _put_pair(d, offs >> 8);
+        d = _put_pair(d, offs);
+        *d++ = ' ';
+        *d++ = ' ';
+    }
+
+    for (unsigned int i = 0; i < width; i++) {
+        if (i && !(i & 7))
+            *d++ = ' ';
+
+        if (i < n) {
+            d = _put_pair(d, p[i]);
+        }
+        else {
+            *d++ = ' ';
+            *d++ = ' ';
+        }
+        *d++ = ' ';
+    }
+
+    if (!hexdump_opts.no_ascii) {
+        *d++ = ' ';
+        *d++ = '|';
+        for (unsigned int i = 0; i < n; i++)
+            *d++ = (p[i] >= 0x20 && p[i] < 0x7f) ? p[i] : '.';
+        *d++ = '|';
+    }
+
+    *d++ = '\n';
+
+    hd->olen = d - hd->obuf;
+    hd->offset += n;
+}
+
+void hexdump_flush(void)
+{
+    struct hexdump_s *hd = &hexdump_data;
+
+    if (hd->nrow) {
+        _row_format(hd->row, hd->nrow);
+        hd->nrow = 0;
+    }
+
+    _obuf_flush();
+}
+
+static void _on_idle_timeout(uv_timer_t *handle)
+{
+    TRACE(TRACE_TIMER, TRACE_TIMER_IDLE_FLUSH);
+    hexdump_flush();
+}
+
+void hexdump_write(const void *data, size_t size, bool timestamp)
+{
+    struct hexdump_s *hd = &hexdump_data;
+    const unsigned char *p = data;
+    const unsigned int width = hexdump_opts.width;
+
+    // once per chunk. all rows received at the same time
+    hd->tslen = 0;
+    if (timestamp) {
+        int rc = str_iso8601_short(hd->ts, sizeof(hd->ts));
+        if (rc > 0)
+            hd->tslen = rc;
+    }
+
+    if (hd->nrow) {
+        size_t n = width - hd->nrow;
+        if (n > size)
+            n = size;
+
+        memcpy(&hd->row[hd->nrow], p, n);
+        hd->nrow += n;
+        p += n;
+        size -= n;
+
+        if (hd->nrow == width) {
+            _row_format(hd->row, width);
+            hd->nrow = 0;
+        }
+    }
+
+    for (; size >= width; p += width, size -= width)
+        _row_format(p, width);
+
+    if (size) {
+        memcpy(hd->row, p, size);
+        hd->nrow = size;
+    }
+
+    _obuf_flush();
+
+    if (!hd->initialized)
+        return;
+
+    int err = hd->nrow
+                  ? uv_timer_start(&hd->timer, _on_idle_timeout,
+                                   HEXDUMP_IDLE_MS, 0)
+                  : uv_timer_stop(&hd->timer);
+    assert_uv_ok(err, "hexdump timer");
+}
+
+void hexdump_init(void)
+{
+    struct hexdump_s *hd = &hexdump_data;
+
+    if (!hexdump_opts.enable)
+        return;
+
+    int err = uv_timer_init(uv_default_loop(), &hd->timer);
+    assert_uv_ok(err, "uv_timer_init");
+
+    hd->initialized = true;
+}
+
+static int _parse_cb_width(const struct opt_conf *conf, char *sval)
+{
+    int width;
+    int err = strto_i(sval, NULL, 0, &width);
+    if (err || width < 1 || width > HEXDUMP_WIDTH_MAX)
+        return opt_perror(conf, "expected 1 to %d", HEXDUMP_WIDTH_MAX);
+
+    hexdump_opts.width = width;
+    return 0;
+}
+
+static const struct opt_conf hexdump_opts_conf[] = {
+    {
+        .name = "hexdump",
+        .dest = &hexdump_opts.enable,
+        .parse = opt_parse_flag_true,
+        .descr = "show received data as hexdump. Rows timestamped with "
+                 "--timestamp",
+    },
+    {
+        .name = "hexdump-width",
+        .parse = _parse_cb_width,
+        .metavar = "BYTES",
+        .descr = "bytes per hexdump row. Default: "
+                 STRINGIFY(HEXDUMP_WIDTH_DEFAULT),
+    },
+    {
+        .name = "hexdump-no-offset",
+        .dest = &hexdump_opts.no_offset,
+        .parse = opt_parse_flag_true,
+        .descr = "no offset column in hexdump",
+    },
+    {
+        .name = "hexdump-no-ascii",
+        .dest = &hexdump_opts.no_ascii,
+        .parse = opt_parse_flag_true,
+        .descr = "no ascii column in hexdump",
+    },
+};
+
+OPT_SECTION_ADD(hexdump,
+                hexdump_opts_conf,
+                ARRAY_LEN(hexdump_opts_conf),
+                NULL);
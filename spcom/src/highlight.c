@@ -0,0 +1,295 @@
+/**
+ * rule based highlighting of received data, e.g. "ERR" in red or hex
+ * addresses in cyan. Rule format, quoted as shell commands:
+ *
+ *     PATTERN COLOR [line] [re]
+ *
+ *   - `line` color the whole line instead of only the match
+ *   - `re`   PATTERN is a regex (see rematch.h), otherwise a fixed string
+ *
+ * Fixed strings of all rules are compiled into one Aho-Corasick automaton.
+ * Regex rules are only tried (anchored) at bytes they can start with, using a
+ * table of first bytes for all regex rules. Both are done once per chunk
+ * before outfmt_write() which applies the marks while building output.
+ *
+ * Fixed strings are matched across chunks, regexes only within a chunk.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+// deps
+#include <uv.h>
+// local
+#include "acmatch.h"
+#include "assert.h"
+#include "common.h"
+#include "highlight.h"
+#include "log.h"
+#include "opt.h"
+#include "outfmt.h"
+#include "rematch.h"
+#include "str.h"
+#include "vt_defs.h"
+
+/// regex rules are bits in a uint64_t
+#define HIGHLIGHT_RE_MAX 64
+
+struct hl_rule {
+    /// owned (strdup) as options parsed before init
+    char *pattern;
+    const char *color;
+    bool line;
+    /// NULL if fixed string
+    struct rematch *re;
+};
+
+static struct highlight_s {
+    struct hl_rule *rules;
+    int nrules;
+    /// fixed strings. acmatch id to rule index
+    struct acmatch *ac;
+    int *ac_rule;
+    /// regex rule index
+    int re_rule[HIGHLIGHT_RE_MAX];
+    int nre;
+    /// bit n set if regex rule n can start with byte
+    uint64_t re_first[256];
+    /// stats
+    size_t nbytes;
+    uint64_t nsec;
+} highlight_data;
+
+static const struct {
+    const char *name;
+    const char *code;
+} hl_colors[] = {
+    { "red", VT_COLOR_RED },
+    { "green", VT_COLOR_GREEN },
+    { "yellow", VT_COLOR_YELLOW },
+    { "blue", VT_COLOR_BLUE },
+    { "magenta", VT_COLOR_MAGENTA },
+    { "cyan", VT_COLOR_CYAN },
+    { "gray", VT_COLOR_BOLDGRAY },
+    { "white", VT_COLOR_BOLDWHITE },
+    { "bold", VT_COLOR_HIGHLIGHT },
+};
+
+static const char *_color_lookup(const char *name)
+{
+    for (int i = 0; i < ARRAY_LEN(hl_colors); i++) {
+        if (!strcmp(hl_colors[i].name, name))
+            return hl_colors[i].code;
+    }
+
+    return NULL;
+}
+
+static void _mark(const struct hl_rule *r, size_t start, size_t end)
+{
+    if (r->line)
+        outfmt_mark_line(start, r->color);
+    else
+        outfmt_mark(start, end, r->color);
+}
+
+static void _on_match(int id, size_t end, void *arg)
+{
+    struct highlight_s *hd = &highlight_data;
+    const struct hl_rule *r = &hd->rules[hd->ac_rule[id]];
+
+    // match could have started in previous chunk
+    size_t len = acmatch_pattern_len(hd->ac, id);
+    size_t start = (end > len) ? end - len : 0;
+
+    _mark(r, start, end);
+}
+
+static void _feed_re(const unsigned char *p, size_t size)
+{
+    struct highlight_s *hd = &highlight_data;
+    // no overlapping matches of same rule
+    size_t next[HIGHLIGHT_RE_MAX] = { 0 };
+
+    for (size_t i = 0; i < size; i++) {
+        uint64_t m = hd->re_first[p[i]];
+
+        while (m) {
+            int n = __builtin_ctzll(m);
+            m &= m - 1;
+
+            if (i < next[n])
+                continue;
+
+            const struct hl_rule *r = &hd->rules[hd->re_rule[n]];
+            size_t len = rematch_match_at(r->re, &p[i], size - i);
+            if (!len)
+                continue;
+
+            _mark(r, i, i + len);
+            next[n] = i + len;
+        }
+    }
+}
+
+void highlight_feed(const void *data, size_t size)
+{
+    struct highlight_s *hd = &highlight_data;
+
+    if (!hd->nrules)
+        return;
+
+    uint64_t t0 = uv_hrtime();
+
+    if (hd->ac)
+        acmatch_feed(hd->ac, data, size, _on_match, NULL);
+
+    if (hd->nre)
+        _feed_re(data, size);
+
+    hd->nsec += uv_hrtime() - t0;
+    hd->nbytes += size;
+}
+
+void highlight_init(void)
+{
+    struct highlight_s *hd = &highlight_data;
+
+    if (!hd->nrules)
+        return;
+
+    for (int i = 0; i < hd->nrules; i++) {
+        struct hl_rule *r = &hd->rules[i];
+
+        if (!r->re) {
+            if (!hd->ac)
+                hd->ac = acmatch_new();
+
+            int id = acmatch_add(hd->ac, r->pattern, strlen(r->pattern));
+            assert(id >= 0);
+            hd->ac_rule = realloc(hd->ac_rule, (id + 1) * sizeof(int));
+            assert(hd->ac_rule);
+            hd->ac_rule[id] = i;
+            continue;
+        }
+
+        if (hd->nre >= HIGHLIGHT_RE_MAX)
+            SPCOM_EXIT(EX_USAGE, "max %d highlight regex", HIGHLIGHT_RE_MAX);
+
+        // positions reachable from start, moved to first pattern position
+        rematch_reset(r->re);
+        uint64_t first = r->re->state << 1;
+        for (int c = 0; c < 256; c++) {
+            if (r->re->table[c] & first)
+                hd->re_first[c] |= (uint64_t)1 << hd->nre;
+        }
+
+        hd->re_rule[hd->nre++] = i;
+    }
+
+    if (hd->ac) {
+        int err = acmatch_compile(hd->ac);
+        if (err)
+            SPCOM_EXIT(EX_USAGE, "highlight - %s", strerror(-err));
+    }
+
+    LOG_DBG("%d highlight rules, %d regex", hd->nrules, hd->nre);
+}
+
+void highlight_cleanup(void)
+{
+    struct highlight_s *hd = &highlight_data;
+
+    if (hd->nbytes) {
+        double sec = hd->nsec / 1e9;
+        LOG_DBG("highlight %zu bytes in %.3f ms, %.1f MB/s",
+                hd->nbytes, sec * 1e3,
+                sec > 0 ? hd->nbytes / sec / 1e6 : 0.0);
+    }
+
+    acmatch_free(hd->ac);
+    hd->ac = NULL;
+    free(hd->ac_rule);
+    hd->ac_rule = NULL;
+}
+
+/// @param s modified
+static int _parse_rule(char *s)
+{
+    struct hl_rule r = { 0 };
+    bool regex = false;
+    int argc = 0;
+    char *argv[8];
+
+    int err = str_split_quoted(s, &argc, argv, ARRAY_LEN(argv));
+    if (err || argc < 2 || argv[0][0] == '\0')
+        return -EINVAL;
+
+    r.color = _color_lookup(argv[1]);
+    if (!r.color)
+        return -EINVAL;
+
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "line"))
+            r.line = true;
+        else if (!strcmp(argv[i], "re"))
+            regex = true;
+        else
+            return -EINVAL;
+    }
+
+    if (regex) {
+        r.re = malloc(sizeof(*r.re));
+        assert(r.re);
+        if (rematch_compile(r.re, argv[0], false)) {
+            free(r.re);
+            return -EINVAL;
+        }
+    }
+
+    r.pattern = strdup(argv[0]);
+    assert(r.pattern);
+
+    struct highlight_s *hd = &highlight_data;
+    hd->rules = realloc(hd->rules, (hd->nrules + 1) * sizeof(*hd->rules));
+    assert(hd->rules);
+    hd->rules[hd->nrules++] = r;
+
+    return 0;
+}
+
+static int _parse_cb_highlight(const struct opt_conf *conf, char *sval)
+{
+    if (_parse_rule(sval))
+        return opt_perror(conf, "invalid highlight rule");
+
+    return 0;
+}
+
+static int _parse_cb_highlight_file(const struct opt_conf *conf, char *sval)
+{
+    return opt_parse_file_lines(conf, sval, _parse_rule);
+}
+
+static const struct opt_conf highlight_opts_conf[] = {
+    {
+        .name = "highlight",
+        .parse = _parse_cb_highlight,
+        .metavar = "\"PATTERN COLOR [line] [re]\"",
+        .descr = "color received PATTERN, or whole line with `line`. "
+                 "Colors: red, green, yellow, blue, magenta, cyan, gray, "
+                 "white, bold. Can be repeated",
+    },
+    {
+        .name = "highlight-file",
+        .parse = _parse_cb_highlight_file,
+        .metavar = "FILE",
+        .descr = "read highlight rules from file. One per line, same format "
+                 "as --highlight. Lines starting with '#' ignored",
+    },
+};
+
+OPT_SECTION_ADD(highlight,
+                highlight_opts_conf,
+                ARRAY_LEN(highlight_opts_conf),
+                NULL);
@@ -0,0 +1,440 @@
+/**
+ * JSON Lines output, i.e. one JSON object per line sent or received:
+ *
+ *     {"ts":1700000000.123456,"port":"/dev/ttyUSB0","dir":"rx","text":"ok"}
+ *
+ * `ts` is epoch seconds (same as capture file) of the first byte of the line.
+ * Line end (see --eol) not included in `text`. Valid UTF-8 is copied as is.
+ * Lines with non-printable bytes or bytes not valid as UTF-8 also get a `hex`
+ * member with the raw bytes, as `text` is lossy for those. Frames (see
+ * --frame) have `frame` and `status` members and always `hex`.
+ *
+ * Escaping is one pass over a 256 entry table. Records are formatted into a
+ * output buffer written once per received chunk, grown if a frame does not
+ * fit (see --frame-max). Incomplete lines are written after JSONL_IDLE_MS
+ * without data or when line buffer is full.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+// deps
+#include <uv.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "ctohex.h"
+#include "eol.h"
+#include "jsonl.h"
+#include "linefilt.h"
+#include "log.h"
+#include "opt.h"
+#include "port_opts.h"
+#include "shell.h"
+#include "trace.h"
+
+/// same as default --eol-rx-timeout
+#define JSONL_IDLE_MS 1000
+#define JSONL_LINE_MAX 4096
+#define JSONL_PORT_MAX 256
+#define JSONL_OBUF_SIZE (64 * 1024)
+
+/// upper bound of record size. escaped text, hex and members
+#define JSONL_RECORD_SIZE_MAX(len) (8 * (len) + 6 * JSONL_PORT_MAX + 128)
+
+enum jsonl_format {
+    JSONL_FORMAT_TEXT = 0,
+    JSONL_FORMAT_JSONL,
+};
+
+struct jsonl_line {
+    int prev_c;
+    /// realtime of first byte
+    struct timespec ts;
+    size_t len;
+    unsigned char buf[JSONL_LINE_MAX];
+};
+
+static struct jsonl_opts_s {
+    int format;
+} jsonl_opts;
+
+static struct jsonl_s {
+    bool initialized;
+    uv_timer_t timer;
+    /// escaped port name
+    char port[6 * JSONL_PORT_MAX + 1];
+    struct jsonl_line lines[JSONL_DIR_COUNT];
+    size_t olen;
+    size_t osize;
+    char *obuf;
+} jsonl_data;
+
+static const char *jsonl_dir_str[] = {
+    [JSONL_DIR_RX] = "rx",
+    [JSONL_DIR_TX] = "tx",
+};
+
+/**
+ * escape char, `u` for `\u00XX` or zero if copied as is. `m` for start of a
+ * UTF-8 sequence, copied if valid, else `\u00XX`
+ */
+static const char jsonl_esc[256] = {
+    [0x00 ... 0x1f] = 'u',
+    ['\b'] = 'b',
+    ['\t'] = 't',
+    ['\n'] = 'n',
+    ['\f'] = 'f',
+    ['\r'] = 'r',
+    ['"'] = '"',
+    ['\\'] = '\\',
+    [0x7f] = 'u',
+    [0x80 ... 0xff] = 'm',
+};
+
+bool jsonl_is_enabled(void)
+{
+    return jsonl_opts.format == JSONL_FORMAT_JSONL;
+}
+
+static void _obuf_flush(void)
+{
+    struct jsonl_s *jd = &jsonl_data;
+
+    if (!jd->olen)
+        return;
+
+    shell_write(STDOUT_FILENO, jd->obuf, jd->olen);
+    jd->olen = 0;
+}
+
+/**
+ * @return length of valid UTF-8 sequence at `p`, zero if not valid, e.g.
+ * overlong, surrogate or truncated
+ */
+static size_t _utf8_len(const unsigned char *p, size_t len)
+{
+    const unsigned char c = p[0];
+    uint32_t cp;
+    uint32_t min;
+    size_t n;
+
+    if (c >= 0xc2 && c <= 0xdf) {
+        n = 2;
+        cp = c & 0x1f;
+        min = 0x80;
+    }
+    else if ((c & 0xf0) == 0xe0) {
+        n = 3;
+        cp = c & 0x0f;
+        min = 0x800;
+    }
+    else if (c >= 0xf0 && c <= 0xf4) {
+        n = 4;
+        cp = c & 0x07;
+        min = 0x10000;
+    }
+    else {
+        return 0;
+    }
+
+    if (n > len)
+        return 0;
+
+    for (size_t i = 1; i < n; i++) {
+        if ((p[i] & 0xc0) != 0x80)
+            return 0;
+        cp = (cp << 6) | (p[i] & 0x3f);
+    }
+
+    if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+        return 0;
+
+    return n;
+}
+
+/**
+ * @param nonprint set if any byte is escaped as not printable or not valid
+ * UTF-8
+ * @return end of escaped string
+ */
+static char *_escape(char *d, const unsigned char *p, size_t len,
+                     bool *nonprint)
+{
+    bool np = false;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = p[i];
+        char e = jsonl_esc[c];
+
+        if (!e) {
+            *d++ = c;
+            continue;
+        }
+
+        if (e == 'm') {
+            size_t n = _utf8_len(&p[i], len - i);
+            if (n) {
+                memcpy(d, &p[i], n);
+                d += n;
+                i += n - 1;
+                continue;
+            }
+            e = 'u';
+        }
+
+        *d++ = '\\';
+        if (e == 'u') {
+            memcpy(d, "u00", 3);
+            memcpy(&d[3], &ctohex_pairs[2 * c], 2);
+            d += 5;
+            np = true;
+            continue;
+        }
+
+        *d++ = e;
+        np |= (e == 'b' || e == 'f');
+    }
+
+    if (nonprint)
+        *nonprint = np;
+
+    return d;
+}
+
+static char *_put_hex(char *d, const unsigned char *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        memcpy(d, &ctohex_pairs[2 * p[i]], 2);
+        d += 2;
+    }
+
+    return d;
+}
+
+static char *_record_start(const struct timespec *ts, enum jsonl_dir dir,
+                           size_t len)
+{
+    struct jsonl_s *jd = &jsonl_data;
+
+    const size_t size_needed = JSONL_RECORD_SIZE_MAX(len);
+
+    if (jd->olen + size_needed > jd->osize)
+        _obuf_flush();
+
+    if (size_needed > jd->osize) {
+        jd->obuf = realloc(jd->obuf, size_needed);
+        assert(jd->obuf);
+        jd->osize = size_needed;
+    }
+
+    char *d = &jd->obuf[jd->olen];
+    d += sprintf(d, "{\"ts\":%lld.%06ld,\"port\":\"%s\",\"dir\":\"%s\"",
+                 (long long)ts->tv_sec, ts->tv_nsec / 1000, jd->port,
+                 jsonl_dir_str[dir]);
+
+    return d;
+}
+
+static void _record_end(char *d)
+{
+    struct jsonl_s *jd = &jsonl_data;
+
+    *d++ = '}';
+    *d++ = '\n';
+    jd->olen = d - jd->obuf;
+}
+
+static void _line_emit(enum jsonl_dir dir)
+{
+    struct jsonl_line *ln = &jsonl_data.lines[dir];
+    bool nonprint;
+
+    if (dir == JSONL_DIR_RX && linefilt_is_enabled()
+        && !linefilt_match((const char *)ln->buf, ln->len)) {
+        ln->len = 0;
+        return;
+    }
+
+    char *d = _record_start(&ln->ts, dir, ln->len);
+
+    memcpy(d, ",\"text\":\"", 9);
+    d = _escape(d + 9, ln->buf, ln->len, &nonprint);
+    *d++ = '"';
+
+    if (nonprint) {
+        memcpy(d, ",\"hex\":\"", 8);
+        d = _put_hex(d + 8, ln->buf, ln->len);
+        *d++ = '"';
+    }
+
+    _record_end(d);
+    ln->len = 0;
+}
+
+static inline void _line_putc(enum jsonl_dir dir, int c)
+{
+    struct jsonl_line *ln = &jsonl_data.lines[dir];
+
+    if (!ln->len) {
+        int err = clock_gettime(CLOCK_REALTIME, &ln->ts);
+        (void)err; // should not fail
+    }
+
+    ln->buf[ln->len++] = c;
+    if (ln->len == sizeof(ln->buf))
+        _line_emit(dir);
+}
+
+void jsonl_flush(void)
+{
+    struct jsonl_s *jd = &jsonl_data;
+
+    for (int i = 0; i < JSONL_DIR_COUNT; i++) {
+        if (jd->lines[i].len)
+            _line_emit(i);
+    }
+
+    _obuf_flush();
+}
+
+static void _on_idle_timeout(uv_timer_t *handle)
+{
+    TRACE(TRACE_TIMER, TRACE_TIMER_IDLE_FLUSH);
+    jsonl_flush();
+}
+
+void jsonl_write(enum jsonl_dir dir, const void *data, size_t size)
+{
+    struct jsonl_s *jd = &jsonl_data;
+    struct jsonl_line *ln = &jd->lines[dir];
+    const struct eol_seq *es = (dir == JSONL_DIR_TX) ? eol_tx : eol_rx;
+    const unsigned char *p = data;
+
+    if (!size)
+        return;
+
+    for (size_t i = 0; i < size; i++) {
+        int c = p[i];
+
+        switch (eol_match(es, ln->prev_c, c)) {
+            case EOL_C_NOMATCH:
+                _line_putc(dir, c);
+                break;
+
+            case EOL_C_MATCH:
+                _line_emit(dir);
+                break;
+
+            case EOL_C_POP:
+                _line_putc(dir, ln->prev_c);
+                _line_putc(dir, c);
+                break;
+
+            case EOL_C_POP_AND_STASH:
+                _line_putc(dir, ln->prev_c);
+                break;
+
+            case EOL_C_IGNORE:
+            case EOL_C_STASH:
+                break;
+
+            default:
+                assert(0);
+                break;
+        }
+        ln->prev_c = c;
+    }
+
+    _obuf_flush();
+
+    if (!jd->initialized)
+        return;
+
+    bool pending = false;
+    for (int i = 0; i < JSONL_DIR_COUNT; i++)
+        pending |= jd->lines[i].len > 0;
+
+    int err = pending ? uv_timer_start(&jd->timer, _on_idle_timeout,
+                                       JSONL_IDLE_MS, 0)
+                      : uv_timer_stop(&jd->timer);
+    assert_uv_ok(err, "jsonl timer");
+}
+
+void jsonl_frame(size_t num, const char *status, const void *data,
+                 size_t size)
+{
+    struct timespec ts;
+    bool nonprint;
+
+    int err = clock_gettime(CLOCK_REALTIME, &ts);
+    (void)err; // should not fail
+
+    char *d = _record_start(&ts, JSONL_DIR_RX, size);
+    d += sprintf(d, ",\"frame\":%zu,\"status\":\"%s\",\"text\":\"", num,
+                 status);
+    d = _escape(d, data, size, &nonprint);
+
+    memcpy(d, "\",\"hex\":\"", 9);
+    d = _put_hex(d + 9, data, size);
+    *d++ = '"';
+
+    _record_end(d);
+    _obuf_flush();
+}
+
+void jsonl_init(void)
+{
+    struct jsonl_s *jd = &jsonl_data;
+
+    if (!jsonl_is_enabled())
+        return;
+
+    for (int i = 0; i < JSONL_DIR_COUNT; i++)
+        jd->lines[i].prev_c = -1;
+
+    // escaped once, same in every record
+    const char *name = port_opts->name ? port_opts->name : "";
+    size_t len = strnlen(name, JSONL_PORT_MAX);
+    char *end = _escape(jd->port, (const unsigned char *)name, len, NULL);
+    *end = '\0';
+
+    jd->osize = JSONL_OBUF_SIZE;
+    jd->obuf = malloc(jd->osize);
+    assert(jd->obuf);
+
+    int err = uv_timer_init(uv_default_loop(), &jd->timer);
+    assert_uv_ok(err, "uv_timer_init");
+
+    jd->initialized = true;
+}
+
+static int _parse_cb_format(const struct opt_conf *conf, char *sval)
+{
+    if (!strcmp(sval, "text"))
+        jsonl_opts.format = JSONL_FORMAT_TEXT;
+    else if (!strcmp(sval, "jsonl"))
+        jsonl_opts.format = JSONL_FORMAT_JSONL;
+    else
+        return opt_perror(conf, "unknown format '%s'", sval);
+
+    return 0;
+}
+
+static const struct opt_conf jsonl_opts_conf[] = {
+    {
+        .name = "format",
+        .parse = _parse_cb_format,
+        .metavar = "FMT",
+        .descr = "output format. FMT: text (default) or jsonl, one JSON "
+                 "object per line sent or received, e.g. for scripts",
+    },
+};
+
+OPT_SECTION_ADD(jsonl,
+                jsonl_opts_conf,
+                ARRAY_LEN(jsonl_opts_conf),
+                NULL);
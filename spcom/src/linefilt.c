@@ -0,0 +1,156 @@
+/**
+ * line filter (grep mode) for displayed output. Lines are matched on received
+ * bytes without eol, i.e. not on timestamp, highlight colors or charmap
+ * representations. Capture file and other consumers always get the unfiltered
+ * stream.
+ *
+ * A line is shown if it matches any include filter (or there are none) and
+ * no exclude filter.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "linefilt.h"
+#include "opt.h"
+#include "rematch.h"
+#include "str.h"
+
+struct linefilt {
+    /// fixed string, or NULL if regex
+    const char *s;
+    size_t len;
+    struct rematch *re;
+    bool exclude;
+};
+
+static struct linefilt_s {
+    struct linefilt *filters;
+    int nfilters;
+    int ninclude;
+} linefilt_data;
+
+bool linefilt_is_enabled(void)
+{
+    return linefilt_data.nfilters > 0;
+}
+
+static bool _match(struct linefilt *f, const char *line, size_t len)
+{
+    if (!f->re)
+        return str_memmem(line, len, f->s, f->len) != NULL;
+
+    rematch_reset(f->re);
+    return rematch_feed(f->re, line, len) > 0;
+}
+
+bool linefilt_match(const char *line, size_t len)
+{
+    const struct linefilt_s *lf = &linefilt_data;
+    bool include = !lf->ninclude;
+
+    for (int i = 0; i < lf->nfilters; i++) {
+        struct linefilt *f = &lf->filters[i];
+
+        // no need to check more includes once one matched
+        if (include && !f->exclude)
+            continue;
+
+        if (_match(f, line, len)) {
+            if (f->exclude)
+                return false;
+            include = true;
+        }
+    }
+
+    return include;
+}
+
+static int _add(const struct opt_conf *conf, char *sval, bool regex,
+                bool exclude)
+{
+    struct linefilt f = {
+        .s = sval,
+        .len = strlen(sval),
+        .exclude = exclude,
+    };
+
+    if (!f.len)
+        return opt_perror(conf, "empty pattern");
+
+    if (regex) {
+        f.s = NULL;
+        f.re = malloc(sizeof(*f.re));
+        assert(f.re);
+        if (rematch_compile(f.re, sval, false)) {
+            free(f.re);
+            return opt_perror(conf, "invalid regex '%s'", sval);
+        }
+    }
+
+    struct linefilt_s *lf = &linefilt_data;
+    lf->filters = realloc(lf->filters, (lf->nfilters + 1) * sizeof(f));
+    assert(lf->filters);
+    lf->filters[lf->nfilters++] = f;
+
+    if (!exclude)
+        lf->ninclude++;
+
+    return 0;
+}
+
+static int _parse_cb_include(const struct opt_conf *conf, char *sval)
+{
+    return _add(conf, sval, false, false);
+}
+
+static int _parse_cb_exclude(const struct opt_conf *conf, char *sval)
+{
+    return _add(conf, sval, false, true);
+}
+
+static int _parse_cb_include_re(const struct opt_conf *conf, char *sval)
+{
+    return _add(conf, sval, true, false);
+}
+
+static int _parse_cb_exclude_re(const struct opt_conf *conf, char *sval)
+{
+    return _add(conf, sval, true, true);
+}
+
+static const struct opt_conf linefilt_opts_conf[] = {
+    {
+        .name = "filter",
+        .parse = _parse_cb_include,
+        .metavar = "STRING",
+        .descr = "only show received lines containing STRING. Can be "
+                 "repeated. Capture file is not filtered",
+    },
+    {
+        .name = "filter-out",
+        .parse = _parse_cb_exclude,
+        .metavar = "STRING",
+        .descr = "do not show received lines containing STRING. Can be "
+                 "repeated",
+    },
+    {
+        .name = "filter-re",
+        .parse = _parse_cb_include_re,
+        .metavar = "REGEX",
+        .descr = "same as --filter with regex (subset, no anchors)",
+    },
+    {
+        .name = "filter-out-re",
+        .parse = _parse_cb_exclude_re,
+        .metavar = "REGEX",
+        .descr = "same as --filter-out with regex",
+    },
+};
+
+OPT_SECTION_ADD(linefilt,
+                linefilt_opts_conf,
+                ARRAY_LEN(linefilt_opts_conf),
+                NULL);
@@ -1,16 +1,29 @@
+/**
+ * Log records are formatted by the caller into a fixed size record. Records
+ * to stderr are written directly, as they must be ordered with other terminal
+ * output. Records to log file are queued on a lock-free ring (multiple
+ * producers, i.e. any thread may log) and written by a background thread, so
+ * file I/O never blocks the event loop. Records are dropped, and counted, if
+ * the ring is full.
+ *
+ * Format arguments are not deferred to the writer thread as `%s` arguments
+ * often point to temporary buffers.
+ */
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include <uv.h>
 #include <libserialport.h>
 
-#include "strbuf.h"
 #include "opt.h"
 #include "shell.h"
 #include "common.h"
 #include "log.h"
+#include "realtime.h"
 
 /**
  * assert RC is greater then zero (printf returns negative on error)
@@ -30,41 +43,150 @@
 
 #define LOG_OPTS_DEFAULT_LEVEL 3
 
+/// max record size, longer records truncated
+#define LOG_RECORD_SIZE 512
+/// number of records in ring. power of two
+#define LOG_RING_LEN 512
+
 struct log_opts_s {
     const char *file;
-    int level;
     int silent;
-} log_opts = {
-    .level = LOG_OPTS_DEFAULT_LEVEL
+} log_opts = { 0 };
+
+int log_level = LOG_OPTS_DEFAULT_LEVEL;
+
+struct log_slot {
+    /// sequence number, see log_ring_push()
+    unsigned int seq;
+    unsigned int len;
+    char text[LOG_RECORD_SIZE];
 };
 
+static struct log_ring_s {
+    /// next slot to write, shared by producers
+    unsigned int head;
+    /// next slot to read, writer thread only
+    unsigned int tail;
+    /// records dropped as ring full
+    unsigned int dropped;
+    bool stop;
+    sem_t sem;
+    struct log_slot slots[LOG_RING_LEN];
+} log_ring;
+
 static struct log_data_s {
     bool initialized;
     FILE *filefp;
-    bool to_stderr;
+    /// file written by writer thread
+    bool async;
+    pthread_t writer;
 } log_data = { 0 };
 
+static void log_ring_init(void)
+{
+    struct log_ring_s *r = &log_ring;
+
+    r->head = 0;
+    r->tail = 0;
+    r->dropped = 0;
+    r->stop = false;
+    for (unsigned int i = 0; i < LOG_RING_LEN; i++)
+        r->slots[i].seq = i;
+}
 
-/* should only be called from strbuf if buf to small */
-static void log_strbuf_flush(struct strbuf *sb)
+/**
+ * bounded MPMC queue by D. Vyukov, here with a single consumer. slot `seq`
+ * equals position when free, position + 1 when written.
+ */
+static void log_ring_push(const char *text, size_t len)
 {
-    /* silent option do not apply to separate file output */
-    if (log_data.filefp) {
-        size_t rc = fwrite(sb->buf, 1, sb->len, log_data.filefp);
-        if (rc != sb->len) {
-            // TODO do what?
+    struct log_ring_s *r = &log_ring;
+    struct log_slot *slot;
+    unsigned int pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+
+    while (1) {
+        slot = &r->slots[pos & (LOG_RING_LEN - 1)];
+        unsigned int seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int diff = (int)(seq - pos);
+
+        if (diff == 0) {
+            // pos updated on failure
+            if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0) {
+            __atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else {
+            pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
         }
     }
 
-    /* output both to file and stderr in some cases */
-    if (log_data.to_stderr) {
-        shell_write(STDERR_FILENO, sb->buf, sb->len);
-    }
+    memcpy(slot->text, text, len);
+    slot->len = len;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    sem_post(&r->sem);
+}
+
+/// @return false if empty
+static bool log_ring_write_one(FILE *fp)
+{
+    struct log_ring_s *r = &log_ring;
+    struct log_slot *slot = &r->slots[r->tail & (LOG_RING_LEN - 1)];
+
+    unsigned int seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq != r->tail + 1)
+        return false;
+
+    size_t rc = fwrite(slot->text, 1, slot->len, fp);
+    (void)rc; // nowhere to report it
+
+    __atomic_store_n(&slot->seq, r->tail + LOG_RING_LEN, __ATOMIC_RELEASE);
+    r->tail++;
+    return true;
+}
+
+static void *log_writer_thread(void *arg)
+{
+    struct log_ring_s *r = &log_ring;
+    FILE *fp = arg;
+    unsigned int dropped = 0;
+
+    while (1) {
+        while (sem_wait(&r->sem) && errno == EINTR)
+            ;
+
+        while (log_ring_write_one(fp))
+            ;
+
+        unsigned int n = __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+        if (n != dropped) {
+            fprintf(fp, "WRN:log: %u records dropped\n", n - dropped);
+            dropped = n;
+        }
 
-    sb->len = 0;
+        // `tail -F` friendly, once per batch
+        fflush(fp);
+
+        if (__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE)) {
+            while (log_ring_write_one(fp))
+                ;
+            fflush(fp);
+            return NULL;
+        }
+    }
 }
 
-STRBUF_STATIC_INIT(log_strbuf, 1024, log_strbuf_flush);
+static void log_file_write(const char *text, size_t len)
+{
+    if (log_data.async)
+        log_ring_push(text, len);
+    else
+        fwrite(text, 1, len, log_data.filefp);
+}
 
 static const char *log_level_to_str(int level)
 {
@@ -95,37 +217,55 @@ void log_vprintf(int level,
         log_init();
     }
 
-    if (level > log_opts.level) {
+    if (!log_is_enabled(level)) {
         return;
     }
 
-    // bool used in strbuf callback
-    log_data.to_stderr = (!log_opts.silent && level <= LOG_LEVEL_INF);
-    if (log_data.to_stderr) {
+    bool to_stderr = (!log_opts.silent && level <= LOG_LEVEL_INF);
+    if (to_stderr) {
         // TODO outfmt_endline();
     }
 
-    struct strbuf *sb = &log_strbuf;
+    /* silent option do not apply to separate file output */
+    if (!to_stderr && !log_data.filefp) {
+        return;
+    }
 
-    strbuf_reset(sb);
+    char rec[LOG_RECORD_SIZE];
+    const size_t size = sizeof(rec) - 1; // room for newline
+    int len;
 
-    const char *levelstr = log_level_to_str(level);
-    if (levelstr) {
-        strbuf_puts(sb, levelstr);
-        strbuf_putc(sb, ':');
+    if (file) {
+        len = snprintf(rec, size, "%s:%s:%u: ", log_level_to_str(level),
+                       file, line);
     }
+    else {
+        len = snprintf(rec, size, "%s: ", log_level_to_str(level));
+    }
+    check_printfrc(len);
+    if (len < 0)
+        return;
 
-    if (file) {
-        strbuf_puts(sb, file);
-        strbuf_putc(sb, ':');
-        strbuf_printf(sb, "%u:", line);
+    int rc = vsnprintf(&rec[len], size - len, fmt, args);
+    check_printfrc(rc);
+    if (rc < 0)
+        rc = 0;
+
+    len += rc;
+    if (len >= size) {
+        len = size - 1;
+        memcpy(&rec[len - 3], "...", 3);
     }
+    rec[len++] = '\n';
 
-    strbuf_putc(sb, ' ');
-    strbuf_vprintf(sb, fmt, args);
-    strbuf_putc(sb, '\n');
+    if (log_data.filefp) {
+        log_file_write(rec, len);
+    }
 
-    log_strbuf_flush(sb);
+    /* output both to file and stderr in some cases */
+    if (to_stderr) {
+        shell_write(STDERR_FILENO, rec, len);
+    }
 }
 
 void log_printf(int level,
@@ -142,17 +282,24 @@ void log_printf(int level,
 
 static void _sp_log_handler(const char *fmt, ...)
 {
-    FILE *fp = log_data.filefp;
-    if (!fp)
+    if (!log_data.filefp)
         return;
 
+    char rec[LOG_RECORD_SIZE];
     va_list args;
 
-    fputs("DBG:SP:", fp);
+    memcpy(rec, "DBG:SP:", 7);
     va_start(args, fmt);
-    int rc = vfprintf(fp, fmt, args);
+    int rc = vsnprintf(&rec[7], sizeof(rec) - 7, fmt, args);
     va_end(args);
-    (void)rc;
+    if (rc < 0)
+        return;
+
+    size_t len = 7 + rc;
+    if (len >= sizeof(rec))
+        len = sizeof(rec) - 1;
+
+    log_file_write(rec, len);
 }
 
 void log_set_debug(int verbose) 
@@ -172,7 +319,7 @@ void log_init(void)
         return;
     }
 
-    int level = log_opts.level;
+    int level = log_level;
 
     log_data.filefp = NULL;
 
@@ -189,8 +336,25 @@ void log_init(void)
                        fpath, strerror(errno));
             return;
         }
-        setlinebuf(fp); // easier debug on `tail -F spcom.log`
         log_data.filefp = fp;
+
+        log_ring_init();
+        int err = sem_init(&log_ring.sem, 0, 0) ? errno : 0;
+        if (!err) {
+            pthread_attr_t attr;
+            realtime_thread_attr_init(&attr);
+            err = pthread_create(&log_data.writer, &attr, log_writer_thread,
+                                 fp);
+            pthread_attr_destroy(&attr);
+        }
+
+        log_data.async = !err;
+        if (!log_data.async) {
+            // written by caller instead
+            setlinebuf(fp); // easier debug on `tail -F spcom.log`
+            fprintf(stderr, "WRN: log writer thread failed '%s'\n",
+                    strerror(err));
+        }
     }
 
     if (level > LOG_LEVEL_DBG) {
@@ -204,6 +368,15 @@ void log_init(void)
 void log_cleanup(void)
 {
     FILE *fp = log_data.filefp;
+
+    if (log_data.async) {
+        __atomic_store_n(&log_ring.stop, true, __ATOMIC_RELEASE);
+        sem_post(&log_ring.sem);
+        pthread_join(log_data.writer, NULL);
+        sem_destroy(&log_ring.sem);
+        log_data.async = false;
+    }
+
     //if ((fp != stderr) && (fp != stdout)) {
     if (fp) {
         fclose(fp);
@@ -216,14 +389,15 @@ void log_cleanup(void)
 static const struct opt_conf log_opts_conf[] = {
     {
         .name = "loglevel",
-        .dest = &log_opts.level,
+        .dest = &log_level,
         .parse = opt_parse_int,
         .descr = "log verbosity level. "
             "Error: " STRINGIFY(LOG_LEVEL_ERR) ", "
             "Warn: " STRINGIFY(LOG_LEVEL_WRN) ", "
             "Info: " STRINGIFY(LOG_LEVEL_INF) ", "
             "Debug: >=" STRINGIFY(LOG_LEVEL_DBG) ", "
-            "Default: " STRINGIFY(LOG_OPTS_DEFAULT_LEVEL)
+            "Default: " STRINGIFY(LOG_OPTS_DEFAULT_LEVEL) ". "
+            "Levels above " STRINGIFY(CONFIG_LOG_LEVEL) " not in this build"
     },
     {
         .name = "logfile",
@@ -7,16 +7,32 @@
 #include <uv.h>
 // local
 #include "assert.h"
+#include "capture.h"
 #include "cmd.h"
 #include "common.h"
+#include "ctrl.h"
+#include "detok.h"
+#include "expect.h"
+#include "frame.h"
+#include "hexdump.h"
+#include "jsonl.h"
+#include "highlight.h"
 #include "main_opts.h"
 #include "misc.h"
+#include "modem.h"
 #include "opt.h"
 #include "outfmt.h"
 #include "port.h"
 #include "port_info.h"
+#include "pty_bridge.h"
+#include "realtime.h"
+#include "rfc2217.h"
 #include "shell.h"
+#include "sniff.h"
+#include "stats.h"
 #include "timeout.h"
+#include "trace.h"
+#include "trigger.h"
 
 #ifndef PRE_DEFS_INCLUDE_H_
 #warning "no pre_defs.h"
@@ -38,6 +54,34 @@ int inpipe_init(void);
 
 static void main_cleanup(void);
 
+/** data received from serial port passed on to all consumers. data is only
+ * valid in callback - no copy made here */
+static void main_on_port_rx(const void *data, size_t size)
+{
+    if (sniff_is_active()) {
+        capture_data(CAPTURE_TAG_A2B, data, size);
+        sniff_write(data, size);
+    }
+    else {
+        capture_data(CAPTURE_TAG_RX, data, size);
+    }
+
+    pty_bridge_write(data, size);
+    rfc2217_write(data, size);
+    trigger_feed(data, size);
+
+    if (frame_is_enabled()) {
+        // trigger marks are offsets in this chunk, not in decoded frames
+        outfmt_marks_clear();
+        frame_feed(data, size);
+    }
+    else {
+        highlight_feed(data, size);
+        outfmt_write(data, size);
+    }
+    expect_feed(data, size);
+}
+
 static void on_uv_close(uv_handle_t *handle)
 {
     if (handle) {
@@ -46,6 +90,10 @@ static void on_uv_close(uv_handle_t *handle)
 }
 static void on_uv_walk(uv_handle_t *handle, void *arg)
 {
+    // might already be closed by module cleanup
+    if (uv_is_closing(handle))
+        return;
+
     uv_close(handle, on_uv_close);
 }
 
@@ -89,6 +137,9 @@ void spcom_exit(int exit_code, const char *file, unsigned int line,
      * but then some data lost */
     outfmt_endline();
 
+    if (exit_code == EX_OK)
+        exit_code = trigger_exit_code();
+
     int level = (exit_code == EX_OK) ? LOG_LEVEL_DBG : LOG_LEVEL_ERR;
 
     char msg[64];
@@ -158,6 +209,8 @@ static void main_init(void)
     err = uv_signal_start(&m->ev_sigterm, _uvcb_on_signal, SIGTERM);
     assert_uv_ok(err, "uv_signal_start");
 
+    trace_init();
+
     if (isatty(STDIN_FILENO)) {
         err = shell_init();
         assert_z(err, "shell_init");
@@ -169,8 +222,24 @@ static void main_init(void)
 
     timeout_init();
 
-    // rx callback == outfmt_write
-    port_init(outfmt_write);
+    capture_init();
+    outfmt_init();
+    hexdump_init();
+    jsonl_init();
+    frame_init();
+    highlight_init();
+    trigger_init();
+    rfc2217_init();
+    pty_bridge_init();
+    sniff_init();
+    ctrl_init();
+    modem_init();
+    stats_init();
+
+    port_init(main_on_port_rx);
+
+    // last, i.e. buffers allocated
+    realtime_init();
 }
 
 static void main_cleanup(void)
@@ -186,12 +255,24 @@ static void main_cleanup(void)
     timeout_stop();
 
     shell_cleanup();
+    ctrl_cleanup();
+    rfc2217_cleanup();
+    pty_bridge_cleanup();
+    sniff_cleanup();
+    modem_cleanup();
     port_cleanup();
+    trigger_cleanup();
+    highlight_cleanup();
+    frame_cleanup();
+    detok_cleanup();
+    capture_cleanup();
 
     /* uv handles might be closed here. must be after modules that uses them!*/
     main_uv_cleanup();
 
     outfmt_endline();
+    stats_cleanup();
+    trace_cleanup();
     log_cleanup(); // last before exit
 
     m->cleanup_done = true;
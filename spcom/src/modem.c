@@ -0,0 +1,365 @@
+/**
+ * modem status line monitor, i.e. CTS, DSR, DCD and RI. A thread waits on
+ * line changes with TIOCMIWAIT, or polls with TIOCMGET every `--modem-poll`
+ * ms if not supported by the driver (e.g. pty). Changes are timestamped in
+ * the thread, passed to the event loop with uv_async, then shown as a notice
+ * in the output and written to the capture file:
+ *
+ *     modem 12:00:01.123456 CTS=1 DSR=1 DCD=0* RI=0
+ *
+ * `*` marks lines changed. A pulse shorter than the time to read the lines
+ * after wake up is not shown.
+ *
+ * TIOCMIWAIT only returns on line change, hangup or signal, so the thread is
+ * stopped with a signal.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+// deps
+#include <uv.h>
+// local
+#include "assert.h"
+#include "capture.h"
+#include "common.h"
+#include "log.h"
+#include "modem.h"
+#include "opt.h"
+#include "outfmt.h"
+#include "realtime.h"
+#include "stats.h"
+
+#define MODEM_EVENTS_LEN 64
+#define MODEM_LINES (TIOCM_CTS | TIOCM_DSR | TIOCM_CD | TIOCM_RNG)
+#define MODEM_POLL_MS_DEFAULT 50
+/// retry interval of stop signal, see modem_stop()
+#define MODEM_STOP_RETRY_MS 10
+
+/// signal to interrupt TIOCMIWAIT. not handled by libuv
+#define MODEM_WAKE_SIGNAL SIGRTMIN
+
+struct modem_event {
+    /// realtime, for display
+    struct timespec ts;
+    /// uv_hrtime() at wake up, for latency
+    uint64_t t_wake;
+    int lines;
+    int changed;
+};
+
+static struct modem_opts_s {
+    int enable;
+    int poll_ms;
+} modem_opts = {
+    .poll_ms = MODEM_POLL_MS_DEFAULT,
+};
+
+static struct modem_s {
+    bool initialized;
+    bool running;
+    bool stop;
+    int fd;
+    pthread_t thread;
+    uv_async_t async;
+    /// events from thread to loop
+    pthread_mutex_t lock;
+    unsigned int wridx;
+    unsigned int rdidx;
+    unsigned int dropped;
+    /// errno of initial TIOCMGET, i.e. lines not supported. zero if none
+    int get_err;
+    /// errno of TIOCMIWAIT when polling instead. zero if none
+    int wait_err;
+    struct modem_event events[MODEM_EVENTS_LEN];
+} modem_data = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static const struct {
+    int bit;
+    const char *name;
+} modem_line_names[] = {
+    { TIOCM_CTS, "CTS" },
+    { TIOCM_DSR, "DSR" },
+    { TIOCM_CD, "DCD" },
+    { TIOCM_RNG, "RI" },
+};
+
+bool modem_is_enabled(void)
+{
+    return modem_opts.enable;
+}
+
+/// called from thread
+static void _push(uint64_t t_wake, int lines, int changed)
+{
+    struct modem_s *md = &modem_data;
+    struct modem_event ev = {
+        .t_wake = t_wake,
+        .lines = lines,
+        .changed = changed,
+    };
+
+    int err = clock_gettime(CLOCK_REALTIME, &ev.ts);
+    (void)err; // should not fail
+
+    pthread_mutex_lock(&md->lock);
+    if (md->wridx - md->rdidx < MODEM_EVENTS_LEN)
+        md->events[md->wridx++ % MODEM_EVENTS_LEN] = ev;
+    else
+        md->dropped++;
+    pthread_mutex_unlock(&md->lock);
+
+    uv_async_send(&md->async);
+}
+
+/// called from thread. logged by loop, see _on_async()
+static void _push_err(int *dst, int err)
+{
+    struct modem_s *md = &modem_data;
+
+    pthread_mutex_lock(&md->lock);
+    *dst = err;
+    pthread_mutex_unlock(&md->lock);
+
+    uv_async_send(&md->async);
+}
+
+static void *_thread(void *arg)
+{
+    struct modem_s *md = &modem_data;
+    const int poll_ms = modem_opts.poll_ms;
+    bool polling = false;
+    int prev;
+
+    if (ioctl(md->fd, TIOCMGET, &prev) < 0) {
+        _push_err(&md->get_err, errno);
+        return NULL;
+    }
+
+    // initial state
+    _push(uv_hrtime(), prev, 0);
+
+    while (!__atomic_load_n(&md->stop, __ATOMIC_ACQUIRE)) {
+        if (!polling) {
+            if (ioctl(md->fd, TIOCMIWAIT, MODEM_LINES) < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EIO)
+                    break; // hangup, i.e. port gone
+
+                _push_err(&md->wait_err, errno);
+                polling = true;
+                continue;
+            }
+        }
+        else {
+            struct timespec ts = {
+                .tv_sec = poll_ms / 1000,
+                .tv_nsec = (poll_ms % 1000) * 1000000L,
+            };
+            nanosleep(&ts, NULL);
+        }
+
+        uint64_t t_wake = uv_hrtime();
+        int lines;
+
+        if (ioctl(md->fd, TIOCMGET, &lines) < 0)
+            break;
+
+        int changed = (lines ^ prev) & MODEM_LINES;
+        if (!changed)
+            continue;
+
+        prev = lines;
+        _push(t_wake, lines, changed);
+    }
+
+    return NULL;
+}
+
+static void _show(const struct modem_event *ev)
+{
+    char lines[64];
+    char time[32];
+    struct tm tm;
+    size_t len = 0;
+
+    for (size_t i = 0; i < ARRAY_LEN(modem_line_names); i++) {
+        int bit = modem_line_names[i].bit;
+        len += snprintf(&lines[len], sizeof(lines) - len, " %s=%d%s",
+                        modem_line_names[i].name, !!(ev->lines & bit),
+                        (ev->changed & bit) ? "*" : "");
+    }
+
+    localtime_r(&ev->ts.tv_sec, &tm);
+    strftime(time, sizeof(time), "%H:%M:%S", &tm);
+
+    char text[128];
+    snprintf(text, sizeof(text), "modem %s.%06ld%s", time,
+             ev->ts.tv_nsec / 1000, lines);
+    outfmt_notice(text);
+
+    capture_event(CAPTURE_TAG_EVT, "modem %lld.%06ld%s",
+                  (long long)ev->ts.tv_sec, ev->ts.tv_nsec / 1000, lines);
+}
+
+static void _on_async(uv_async_t *handle)
+{
+    struct modem_s *md = &modem_data;
+    struct modem_event events[MODEM_EVENTS_LEN];
+    unsigned int n = 0;
+    unsigned int dropped;
+    int get_err;
+    int wait_err;
+
+    pthread_mutex_lock(&md->lock);
+    while (md->rdidx != md->wridx)
+        events[n++] = md->events[md->rdidx++ % MODEM_EVENTS_LEN];
+    dropped = md->dropped;
+    md->dropped = 0;
+    get_err = md->get_err;
+    md->get_err = 0;
+    wait_err = md->wait_err;
+    md->wait_err = 0;
+    pthread_mutex_unlock(&md->lock);
+
+    // thread does not log, shell output not thread safe
+    if (get_err)
+        LOG_WRN("modem lines not supported '%s'", strerrorname_np(get_err));
+
+    if (wait_err)
+        LOG_DBG("TIOCMIWAIT %s. polling every %d ms",
+                strerrorname_np(wait_err), modem_opts.poll_ms);
+
+    if (dropped)
+        LOG_WRN("%u modem events dropped", dropped);
+
+    for (unsigned int i = 0; i < n; i++) {
+        _show(&events[i]);
+        stats_hist_add(&stats.modem_latency, uv_hrtime() - events[i].t_wake);
+    }
+}
+
+static void _on_wake_signal(int signum)
+{
+    // only to interrupt ioctl
+}
+
+void modem_start(int fd)
+{
+    struct modem_s *md = &modem_data;
+
+    if (!md->initialized || md->running)
+        return;
+
+    md->fd = fd;
+    md->stop = false;
+
+    pthread_attr_t attr;
+    realtime_thread_attr_init(&attr);
+    int err = pthread_create(&md->thread, &attr, _thread, NULL);
+    pthread_attr_destroy(&attr);
+    if (err) {
+        LOG_ERR("modem thread '%s'", strerror(err));
+        return;
+    }
+
+    md->running = true;
+}
+
+void modem_stop(void)
+{
+    struct modem_s *md = &modem_data;
+
+    if (!md->running)
+        return;
+
+    __atomic_store_n(&md->stop, true, __ATOMIC_RELEASE);
+
+    // signal is lost if thread not yet in ioctl, hence retry
+    for (;;) {
+        struct timespec ts;
+
+        pthread_kill(md->thread, MODEM_WAKE_SIGNAL);
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += MODEM_STOP_RETRY_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        if (pthread_timedjoin_np(md->thread, NULL, &ts) == 0)
+            break;
+    }
+
+    md->running = false;
+}
+
+void modem_init(void)
+{
+    struct modem_s *md = &modem_data;
+
+    if (!modem_opts.enable)
+        return;
+
+    struct sigaction sa = {
+        .sa_handler = _on_wake_signal,
+    };
+    sigemptyset(&sa.sa_mask);
+    // no SA_RESTART, i.e. ioctl fails with EINTR
+    int err = sigaction(MODEM_WAKE_SIGNAL, &sa, NULL);
+    assert(!err);
+
+    err = uv_async_init(uv_default_loop(), &md->async, _on_async);
+    assert_uv_ok(err, "uv_async_init");
+
+    md->initialized = true;
+}
+
+void modem_cleanup(void)
+{
+    modem_stop();
+}
+
+static int _parse_cb_poll(const struct opt_conf *conf, char *sval)
+{
+    int err = opt_parse_int(conf, sval);
+    if (err)
+        return err;
+
+    if (modem_opts.poll_ms < 1)
+        return opt_perror(conf, "must be at least 1 ms");
+
+    return 0;
+}
+
+static const struct opt_conf modem_opts_conf[] = {
+    {
+        .name = "modem-events",
+        .dest = &modem_opts.enable,
+        .parse = opt_parse_flag_true,
+        .descr = "show changes of CTS, DSR, DCD and RI in output, and record "
+                 "them in capture file",
+    },
+    {
+        .name = "modem-poll",
+        .dest = &modem_opts.poll_ms,
+        .parse = _parse_cb_poll,
+        .metavar = "MS",
+        .descr = "modem line poll interval when driver can not wait on "
+                 "changes. Default " STRINGIFY(MODEM_POLL_MS_DEFAULT) " ms",
+    },
+};
+
+OPT_SECTION_ADD(modem,
+                modem_opts_conf,
+                ARRAY_LEN(modem_opts_conf),
+                NULL);
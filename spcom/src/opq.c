@@ -2,15 +2,20 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
+// deps
+#include <uv.h>
 // local
 #include "assert.h"
 #include "common.h"
 #include "opq.h"
+#include "trace.h"
 
 struct opq {
     struct opq_item items[64];
     unsigned int wridx;
     unsigned int rdidx;
+    /// high water mark
+    unsigned int max_len;
     opq_free_cb *write_done_cb;
 };
 
@@ -86,10 +91,42 @@ int opq_enqueue_val(struct opq *q, uint16_t op_code, int val)
     itm->op_code = op_code;
     itm->size = 0;
     itm->u.val = val;
+    itm->free_cb = NULL;
 
     return opq_enqueue_tail(q, itm);
 }
 
+int opq_enqueue_val_cb(struct opq *q, uint16_t op_code, int val,
+                       opq_free_cb *cb)
+{
+    struct opq_item *itm = opq_acquire_tail(q);
+    if (!itm)
+        return -1;
+
+    itm->op_code = op_code;
+    itm->size = 0;
+    itm->u.val = val;
+    itm->free_cb = cb;
+
+    return opq_enqueue_tail(q, itm);
+}
+
+unsigned int opq_space(const struct opq *q)
+{
+    // same off by one as opq_isfull()
+    return ARRAY_LEN(q->items) - 1 - opq_len(q);
+}
+
+unsigned int opq_count(const struct opq *q)
+{
+    return opq_len(q);
+}
+
+unsigned int opq_max_count(const struct opq *q)
+{
+    return q->max_len;
+}
+
 int opq_enqueue_write(struct opq *q, void *data, uint16_t size)
 {
     struct opq_item *itm = opq_acquire_tail(q);
@@ -99,6 +136,24 @@ int opq_enqueue_write(struct opq *q, void *data, uint16_t size)
     itm->op_code = OP_PORT_WRITE;
     itm->size = size;
     itm->u.data = data;
+    itm->free_cb = NULL;
+
+    return opq_enqueue_tail(q, itm);
+}
+
+int opq_enqueue_write_cb(struct opq *q, void *data, uint16_t size,
+                         opq_free_cb *cb)
+{
+    struct opq_item *itm = opq_acquire_tail(q);
+    if (!itm)
+        return -1;
+
+    assert(size);
+
+    itm->op_code = OP_PORT_WRITE;
+    itm->size = size;
+    itm->u.data = data;
+    itm->free_cb = cb;
 
     return opq_enqueue_tail(q, itm);
 }
@@ -110,7 +165,13 @@ int opq_enqueue_tail(struct opq *q, struct opq_item *itm)
     }
 
     assert(itm == &q->items[q->wridx]);
+    TRACE(TRACE_OPQ_ENQUEUE, itm->op_code);
+    itm->ts = uv_hrtime();
+    itm->done = false;
     q->wridx = (q->wridx + 1) % ARRAY_LEN(q->items);
+
+    unsigned int len = opq_len(q);
+    q->max_len = (len > q->max_len) ? len : q->max_len;
     return 0;
 }
 
@@ -147,16 +208,22 @@ void opq_release_head(struct opq *q, struct opq_item *itm)
 {
     // enusre itm is same as head
     assert(itm == &q->items[q->rdidx]);
+    TRACE(TRACE_OPQ_DEQUEUE, itm->op_code);
 
-    if (itm->size) {
+    if (itm->free_cb) {
+        itm->free_cb(itm);
+    }
+    else if (itm->size) {
         if (itm->op_code == OP_PORT_WRITE && q->write_done_cb) {
             q->write_done_cb(itm);
         }
-
-        itm->size = 0;
     }
+    itm->size = 0;
     itm->op_code = 0;
     itm->u = (typeof(itm->u)) { 0 };
+    itm->free_cb = NULL;
+    itm->done = false;
+    itm->forwarded = false;
 
     // update "head"
     q->rdidx = (q->rdidx + 1) % ARRAY_LEN(q->items);
@@ -169,3 +236,20 @@ void opq_release_all(struct opq *q)
         opq_release_head(q, itm);
     }
 }
+
+int opq_transfer(struct opq *dst, struct opq *src)
+{
+    while (!opq_isempty(src)) {
+        struct opq_item *itm = opq_acquire_tail(dst);
+        if (!itm)
+            return -1;
+
+        *itm = src->items[src->rdidx];
+        src->items[src->rdidx] = (struct opq_item) { 0 };
+        src->rdidx = (src->rdidx + 1) % ARRAY_LEN(src->items);
+
+        opq_enqueue_tail(dst, itm);
+    }
+
+    return 0;
+}
@@ -2,11 +2,13 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 // local
 #include "assert.h"
 #include "opt.h"
+#include "str.h"
 #include "strto.h"
 
 #ifndef IS_ALIGNED
@@ -88,3 +90,32 @@ int opt_parse_flag_count(const struct opt_conf *conf, char *s)
     *((int *)conf->dest) += 1;
     return 0;
 }
+
+int opt_parse_file_lines(const struct opt_conf *conf, const char *path,
+                         int (*line_cb)(char *s))
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return opt_perror(conf, "%s '%s'", strerror(errno), path);
+
+    char *line = NULL;
+    size_t n = 0;
+    int lineno = 0;
+    int err = 0;
+
+    while (getline(&line, &n, fp) > 0) {
+        lineno++;
+        char *s = str_strip(line);
+        if (*s == '\0' || *s == '#')
+            continue;
+
+        if (line_cb(s)) {
+            err = opt_perror(conf, "invalid line %d in '%s'", lineno, path);
+            break;
+        }
+    }
+
+    free(line);
+    fclose(fp);
+    return err;
+}
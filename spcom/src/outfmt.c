@@ -1,7 +1,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 // deps
 #include <uv.h>
 // local
@@ -14,13 +16,44 @@
 #include "charmap.h"
 #include "strbuf.h"
 #include "outfmt.h"
+#include "linefilt.h"
+#include "hexdump.h"
+#include "jsonl.h"
 #include "assert.h"
+#include "port.h"
+#include "probe.h"
+#include "stats.h"
+#include "trace.h"
 
 #ifndef CONFIG_EOL_RX_TIMEOUT
 #define CONFIG_EOL_RX_TIMEOUT 1
 #endif
 
 #define EOL_RX_TIMEOUT_DEFAULT 1.0
+#define OUTFMT_MARKS_MAX 128
+/// received bytes of pending line, same as outfmt_strbuf size
+#define OUTFMT_RAW_LINE_SIZE 1024
+
+/// state of current line when filtering
+enum outfmt_line {
+    /// no line in progress, or line to be shown
+    OUTFMT_LINE_ACCEPTED = 0,
+    /// not yet decided, kept in buffer until eol
+    OUTFMT_LINE_PENDING,
+    /// dropped until eol
+    OUTFMT_LINE_REJECTED,
+};
+
+struct outfmt_mark {
+    size_t start;
+    size_t end;
+    const char *color;
+};
+
+struct outfmt_line_mark {
+    size_t offset;
+    const char *color;
+};
 
 static struct outfmt_s {
     bool linebufed;
@@ -28,6 +61,44 @@ static struct outfmt_s {
     bool had_eol;
     int prev_c;
     char last_c_flushed;
+    bool filter;
+    enum outfmt_line line;
+    /// offset in strbuf of current line, before timestamp
+    size_t line_start;
+    /// offset in strbuf of current line text, after timestamp
+    size_t text_start;
+    /// start of current line not yet flushed
+    bool line_in_buf;
+    /**
+     * received bytes of pending line, without eol, copied only once strbuf
+     * text is not as received, i.e. highlight escapes or charmap
+     * representations inserted. filter and dedup match on these if copied,
+     * else on strbuf text. see _raw_detach()
+     */
+    bool raw_copy;
+    size_t raw_len;
+    char raw[OUTFMT_RAW_LINE_SIZE];
+    /// uv_hrtime() of read of oldest data not yet flushed, zero if none
+    uint64_t rx_ts;
+    /// color of current line, if any
+    const char *line_color;
+    /// dedup
+    uint64_t last_hash;
+    bool last_hash_valid;
+    unsigned int repeats;
+    /// rate limit token bucket
+    float tokens;
+    uint64_t tokens_ts;
+    unsigned int suppressed;
+    /// marks for next write
+    unsigned int nmarks;
+    unsigned int mark_idx;
+    bool in_mark;
+    struct outfmt_mark marks[OUTFMT_MARKS_MAX];
+    /// line marks for next write
+    unsigned int nline_marks;
+    unsigned int line_mark_idx;
+    struct outfmt_line_mark line_marks[OUTFMT_MARKS_MAX];
 } outfmt_data = {
     .prev_c = -1,
 };
@@ -39,6 +110,10 @@ static struct outfmt_opts_s {
         const char *remapped;
     } colors;
     int timestamp;
+    int raw_out;
+    int dedup;
+    float rate_limit;
+    int rate_burst;
 } _outfmt_opts = {
     .eol_rx_timeout = EOL_RX_TIMEOUT_DEFAULT,
     .color = false,
@@ -47,13 +122,200 @@ static struct outfmt_opts_s {
     },
 };
 
+/// all received data to stdout, except hexdump and jsonl, goes here
+static void _stdout_write(const void *data, size_t size)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    TRACE(TRACE_OUTFMT_FLUSH, size);
+    PROBE1(outfmt_flush, size);
+
+    uint64_t t0 = uv_hrtime();
+    shell_write(STDOUT_FILENO, data, size);
+    uint64_t t1 = uv_hrtime();
+
+    stats.flushes++;
+    stats.flush_bytes += size;
+    stats.stdout_ns += t1 - t0;
+    if (ofd->rx_ts) {
+        stats_hist_add(&stats.rx_latency, t1 - ofd->rx_ts);
+        ofd->rx_ts = 0;
+    }
+}
+
+/**
+ * flush all but a pending (filtered) line. the pending line is moved to start
+ * of buffer, i.e. only partial lines are ever copied. rejected lines dropped.
+ */
 static void outfmt_strbuf_flush(struct strbuf *sb)
 {
-    shell_write(STDOUT_FILENO, sb->buf, sb->len);
+    struct outfmt_s *ofd = &outfmt_data;
+    size_t n = sb->len;
+
+    if (ofd->line == OUTFMT_LINE_REJECTED)
+        sb->len = n = ofd->line_start;
+    else if (ofd->line == OUTFMT_LINE_PENDING)
+        n = ofd->line_start;
+
+    if (n) {
+        _stdout_write(sb->buf, n);
+        ofd->last_c_flushed = sb->buf[n - 1];
+    }
+
+    if (ofd->line_start < n)
+        ofd->line_in_buf = false;
+
+    // nothing to move unless pending
+    memmove(sb->buf, &sb->buf[n], sb->len - n);
+    sb->len -= n;
+    ofd->line_start = (ofd->line_start > n) ? ofd->line_start - n : 0;
+    ofd->text_start = (ofd->text_start > n) ? ofd->text_start - n : 0;
+
+    // nothing left to display, e.g. rejected line dropped
+    if (!sb->len)
+        ofd->rx_ts = 0;
+}
+
+// FNV-1a
+static uint64_t _line_hash(const char *s, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+/// @return true if same as previous shown line
+static bool _line_is_repeat(const char *text, size_t len)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (!_outfmt_opts.dedup)
+        return false;
+
+    uint64_t h = _line_hash(text, len);
+    if (ofd->last_hash_valid && h == ofd->last_hash) {
+        ofd->repeats++;
+        return true;
+    }
+
+    ofd->last_hash = h;
+    ofd->last_hash_valid = true;
+    return false;
+}
+
+/// token bucket. @return true if line should be suppressed
+static bool _line_is_limited(void)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+    const float rate = _outfmt_opts.rate_limit;
+
+    if (rate <= 0.0f)
+        return false;
+
+    uint64_t now = uv_now(uv_default_loop());
+    ofd->tokens += (now - ofd->tokens_ts) * rate / 1000.0f;
+    ofd->tokens_ts = now;
+
+    if (ofd->tokens > _outfmt_opts.rate_burst)
+        ofd->tokens = _outfmt_opts.rate_burst;
+
+    if (ofd->tokens < 1.0f) {
+        ofd->suppressed++;
+        return true;
+    }
+
+    ofd->tokens -= 1.0f;
+    return false;
+}
+
+__attribute__((format(printf, 1, 2)))
+static void _notice_write(const char *fmt, ...)
+{
+    char buf[160];
+    const bool color = _outfmt_opts.color;
+    va_list args;
+
+    int len = snprintf(buf, sizeof(buf), "%s", color ? VT_COLOR_BOLDGRAY : "");
+    va_start(args, fmt);
+    len += vsnprintf(&buf[len], sizeof(buf) - len - 16, fmt, args);
+    va_end(args);
+    len += snprintf(&buf[len], sizeof(buf) - len, "%s\n",
+                    color ? VT_COLOR_OFF : "");
+    assert(len < sizeof(buf));
+
+    shell_write(STDOUT_FILENO, buf, len);
+    outfmt_data.last_c_flushed = '\n';
+}
+
+/// write "repeated" and "suppressed" notices, before any pending line
+static void _notices_write(struct strbuf *sb)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (!ofd->repeats && !ofd->suppressed)
+        return;
+
+    outfmt_strbuf_flush(sb);
+
+    if (ofd->repeats) {
+        _notice_write("last line repeated %u times", ofd->repeats);
+        ofd->repeats = 0;
+    }
+
+    if (ofd->suppressed) {
+        _notice_write("suppressed %u lines", ofd->suppressed);
+        ofd->suppressed = 0;
+    }
+}
+
+/**
+ * decide on pending line. rejected line is truncated. dedup and rate limit
+ * only applies to complete lines.
+ */
+static void _line_decide(struct strbuf *sb, bool complete)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (ofd->line != OUTFMT_LINE_PENDING)
+        return;
+
+    const char *text =
+        ofd->raw_copy ? ofd->raw : &sb->buf[ofd->text_start];
+    const size_t len =
+        ofd->raw_copy ? ofd->raw_len : sb->len - ofd->text_start;
+
+    bool show = linefilt_match(text, len);
+    if (show && complete)
+        show = !_line_is_repeat(text, len) && !_line_is_limited();
+    else if (show)
+        ofd->last_hash_valid = false;
+
+    if (!show) {
+        ofd->line = OUTFMT_LINE_REJECTED;
+        sb->len = ofd->line_start;
+        return;
+    }
+
+    _notices_write(sb);
+    ofd->line = OUTFMT_LINE_ACCEPTED;
+}
+
+static void outfmt_strbuf_make_space(struct strbuf *sb)
+{
+    struct outfmt_s *ofd = &outfmt_data;
 
-    outfmt_data.last_c_flushed = sb->buf[sb->len];
+    outfmt_strbuf_flush(sb);
 
-    sb->len = 0;
+    // long line filling most of buffer - decide on what we have so far
+    if (ofd->line == OUTFMT_LINE_PENDING && sb->len > sb->bufsize / 2) {
+        _line_decide(sb, false);
+        outfmt_strbuf_flush(sb);
+    }
 }
 
 /**
@@ -62,7 +324,7 @@ static void outfmt_strbuf_flush(struct strbuf *sb)
  * every write to stdout. also fputc is slow...
  * must ensure a flush after strbuf operation(s).
  */
-STRBUF_STATIC_INIT(outfmt_strbuf, 1024, outfmt_strbuf_flush);
+STRBUF_STATIC_INIT(outfmt_strbuf, 1024, outfmt_strbuf_make_space);
 
 #if CONFIG_EOL_RX_TIMEOUT
 static struct {
@@ -73,8 +335,11 @@ static struct {
 static void _eol_rx_timeout_cb(uv_timer_t *handle)
 {
     struct strbuf *sb = &outfmt_strbuf;
+    TRACE(TRACE_TIMER, TRACE_TIMER_EOL_RX);
     LOG_DBG("eol_rx_timeout after %f sec. size in buf %zu",
             _outfmt_opts.eol_rx_timeout, sb->len);
+    _line_decide(sb, false);
+    _notices_write(sb);
     outfmt_strbuf_flush(sb);
 }
 
@@ -92,6 +357,9 @@ static void _eol_rx_timeout_init(void)
 
 static void _eol_rx_timeout_start(void)
 {
+    if (!_eol_rx_timeout_data.msec)
+        return;
+
     int err = uv_timer_start(&_eol_rx_timeout_data.timer,
                              _eol_rx_timeout_cb,
                              _eol_rx_timeout_data.msec,
@@ -102,6 +370,9 @@ static void _eol_rx_timeout_start(void)
 
 static void _eol_rx_timeout_stop(void)
 {
+    if (!_eol_rx_timeout_data.msec)
+        return;
+
     int err = uv_timer_stop(&_eol_rx_timeout_data.timer);
     assert_uv_ok(err, "uv_timer_stop");
     LOG_DBG("eol_rx_timeout stop");
@@ -139,14 +410,75 @@ static void _print_timestamp(struct strbuf *sb)
     sb->len += rc;
 }
 
+static void _line_start(struct strbuf *sb)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (ofd->filter)
+        ofd->line = OUTFMT_LINE_PENDING;
+
+    ofd->line_start = sb->len;
+    ofd->line_in_buf = true;
+    ofd->raw_copy = false;
+    ofd->raw_len = 0;
+
+    _print_timestamp(sb);
+
+    // timestamp might have flushed
+    ofd->text_start = sb->len;
+}
+
+/**
+ * pending line about to get other than received bytes in strbuf. copy text
+ * so far for _line_decide(), received bytes from here on by _raw_putc().
+ * Lines shown as received, i.e. most, are not copied.
+ */
+static void _raw_detach(struct strbuf *sb)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (ofd->line != OUTFMT_LINE_PENDING || ofd->raw_copy)
+        return;
+
+    // pending text never exceeds strbuf size
+    size_t len = sb->len - ofd->text_start;
+    assert(len <= sizeof(ofd->raw));
+
+    memcpy(ofd->raw, &sb->buf[ofd->text_start], len);
+    ofd->raw_len = len;
+    ofd->raw_copy = true;
+}
+
+/// keep received byte of pending line, if detached
+static void _raw_putc(struct strbuf *sb, int c)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (ofd->line != OUTFMT_LINE_PENDING || !ofd->raw_copy)
+        return;
+
+    // long line, e.g. of ignored chars - decide on what we have so far
+    if (ofd->raw_len == sizeof(ofd->raw)) {
+        _line_decide(sb, false);
+        return;
+    }
+
+    ofd->raw[ofd->raw_len++] = c;
+}
+
 static void _sb_remap_putc(struct strbuf *sb, int c)
 {
     int repr_type = charmap_repr_type(charmap_rx, c);
 
     if (repr_type == CHARMAP_REPR_NONE) {
+        _raw_putc(sb, c);
         strbuf_putc(sb, c);
         return;
     }
+
+    _raw_detach(sb);
+    _raw_putc(sb, c);
+
     if (repr_type == CHARMAP_REPR_IGNORE) {
         return;
     }
@@ -168,6 +500,175 @@ static void _sb_remap_putc(struct strbuf *sb, int c)
     }
 }
 
+void outfmt_mark(size_t start, size_t end, const char *color)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+    struct outfmt_mark *marks = ofd->marks;
+
+    if (start >= end)
+        return;
+
+    // sorted by start
+    unsigned int i = ofd->nmarks;
+    while (i > 0 && marks[i - 1].start > start)
+        i--;
+
+    if (i > 0 && start <= marks[i - 1].end) {
+        // overlapping or adjacent with previous
+        i--;
+        if (end > marks[i].end)
+            marks[i].end = end;
+    }
+    else {
+        if (ofd->nmarks >= OUTFMT_MARKS_MAX)
+            return;
+
+        memmove(&marks[i + 1], &marks[i], (ofd->nmarks - i) * sizeof(*marks));
+        marks[i] = (struct outfmt_mark) {
+            .start = start,
+            .end = end,
+            .color = color,
+        };
+        ofd->nmarks++;
+    }
+
+    // merge following now overlapping
+    while (i + 1 < ofd->nmarks && marks[i + 1].start <= marks[i].end) {
+        if (marks[i + 1].end > marks[i].end)
+            marks[i].end = marks[i + 1].end;
+
+        ofd->nmarks--;
+        memmove(&marks[i + 1], &marks[i + 2],
+                (ofd->nmarks - i - 1) * sizeof(*marks));
+    }
+}
+
+void outfmt_mark_line(size_t offset, const char *color)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+    struct outfmt_line_mark *marks = ofd->line_marks;
+
+    if (ofd->nline_marks >= OUTFMT_MARKS_MAX)
+        return;
+
+    unsigned int i = ofd->nline_marks;
+    while (i > 0 && marks[i - 1].offset > offset)
+        i--;
+
+    memmove(&marks[i + 1], &marks[i], (ofd->nline_marks - i) * sizeof(*marks));
+    marks[i] = (struct outfmt_line_mark) {
+        .offset = offset,
+        .color = color,
+    };
+    ofd->nline_marks++;
+}
+
+void outfmt_marks_clear(void)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    ofd->nmarks = 0;
+    ofd->nline_marks = 0;
+}
+
+/**
+ * color current line from start of text. if line start already flushed,
+ * everything in buffer is part of current line.
+ */
+static void _line_color_start(struct strbuf *sb, const char *color)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+    size_t clen = strlen(color);
+
+    _raw_detach(sb);
+    ofd->line_color = color;
+
+    if (strbuf_remains(sb) < clen) {
+        strbuf_puts(sb, color);
+        return;
+    }
+
+    size_t pos = ofd->line_in_buf ? ofd->text_start : 0;
+    if (pos > sb->len)
+        pos = sb->len;
+
+    char *p = &sb->buf[pos];
+    memmove(p + clen, p, sb->len - pos);
+    memcpy(p, color, clen);
+    sb->len += clen;
+}
+
+/// first line mark wins. @return offset of next line mark
+static size_t _line_mark(struct strbuf *sb, size_t offset)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    while (ofd->line_mark_idx < ofd->nline_marks) {
+        const struct outfmt_line_mark *m = &ofd->line_marks[ofd->line_mark_idx];
+        if (m->offset != offset)
+            return m->offset;
+
+        if (!ofd->line_color)
+            _line_color_start(sb, m->color);
+
+        ofd->line_mark_idx++;
+    }
+
+    return SIZE_MAX;
+}
+
+static void _line_color_end(struct strbuf *sb)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (!ofd->line_color)
+        return;
+
+    strbuf_puts(sb, VT_COLOR_OFF);
+    ofd->line_color = NULL;
+}
+
+/// start or end mark at current offset. @return offset of next start or end
+static size_t _mark_toggle(struct strbuf *sb)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+    const struct outfmt_mark *m = &ofd->marks[ofd->mark_idx];
+
+    _raw_detach(sb);
+
+    if (!ofd->in_mark) {
+        strbuf_puts(sb, m->color);
+        ofd->in_mark = true;
+        return m->end;
+    }
+
+    strbuf_puts(sb, VT_COLOR_OFF);
+    ofd->in_mark = false;
+
+    if (ofd->line_color)
+        strbuf_puts(sb, ofd->line_color);
+
+    // adjacent marks merged, i.e. next start always after this end
+    if (++ofd->mark_idx >= ofd->nmarks)
+        return SIZE_MAX;
+
+    return ofd->marks[ofd->mark_idx].start;
+}
+
+static void _marks_reset(struct strbuf *sb)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (ofd->in_mark)
+        strbuf_puts(sb, ofd->line_color ? ofd->line_color : VT_COLOR_OFF);
+
+    ofd->in_mark = false;
+    ofd->mark_idx = 0;
+    ofd->nmarks = 0;
+    ofd->line_mark_idx = 0;
+    ofd->nline_marks = 0;
+}
+
 /**
  * handle seq crlf:
  */
@@ -180,18 +681,51 @@ void outfmt_write(const void *data, size_t size)
     struct strbuf *sb = &outfmt_strbuf;
     struct outfmt_s *ofd = &outfmt_data;
 
+    if (_outfmt_opts.raw_out || jsonl_is_enabled() || hexdump_is_enabled()) {
+        // marks not applicable
+        outfmt_marks_clear();
+
+        if (_outfmt_opts.raw_out) {
+            ofd->rx_ts = port_stats()->rx_time;
+            _stdout_write(data, size); // no copy
+        }
+        else if (jsonl_is_enabled())
+            jsonl_write(JSONL_DIR_RX, data, size);
+        else
+            hexdump_write(data, size, _outfmt_opts.timestamp);
+        return;
+    }
+
+    if (!ofd->rx_ts)
+        ofd->rx_ts = port_stats()->rx_time;
+
     bool is_first_c = ofd->prev_c < 0;
     if (is_first_c)
-        _print_timestamp(sb);
+        _line_start(sb);
+
+    size_t next_mark = ofd->nmarks ? ofd->marks[0].start : SIZE_MAX;
+    size_t next_line_mark =
+        ofd->nline_marks ? ofd->line_marks[0].offset : SIZE_MAX;
+
+    // line color turned off at end of previous write
+    if (ofd->line_color && !ofd->linebufed)
+        strbuf_puts(sb, ofd->line_color);
 
     for (size_t i = 0; i < size; i++) {
         int c = *src++;
+
         // timestamp on first char received _after_ eol
         if (ofd->had_eol) {
-            _print_timestamp(sb);
+            _line_start(sb);
             ofd->had_eol = false;
         }
 
+        if (i == next_mark)
+            next_mark = _mark_toggle(sb);
+
+        if (i == next_line_mark)
+            next_line_mark = _line_mark(sb, i);
+
         int ec = eol_match(eol_rx, ofd->prev_c, c);
         switch (ec) {
 
@@ -201,6 +735,16 @@ void outfmt_write(const void *data, size_t size)
 
             case EOL_C_MATCH:
                 ofd->had_eol = true;
+                if (ofd->filter) {
+                    _line_decide(sb, true);
+                    if (ofd->line == OUTFMT_LINE_REJECTED) {
+                        sb->len = ofd->line_start;
+                        ofd->line = OUTFMT_LINE_ACCEPTED;
+                        ofd->line_color = NULL;
+                        break;
+                    }
+                }
+                _line_color_end(sb);
                 /* outfmt putc no check, "raw" */
                 strbuf_putc(sb, '\n');
                 if (ofd->linebufed) {
@@ -230,22 +774,60 @@ void outfmt_write(const void *data, size_t size)
         ofd->prev_c = c;
     }
 
+    if (ofd->nmarks || ofd->nline_marks)
+        _marks_reset(sb);
+
     if (ofd->linebufed) {
-        if (sb->len > 0) {
+        // notices also written on timeout
+        if (sb->len > 0 || ofd->repeats || ofd->suppressed) {
             _eol_rx_timeout_start();
         }
     }
     else {
+        if (ofd->line_color)
+            strbuf_puts(sb, VT_COLOR_OFF);
         outfmt_strbuf_flush(sb);
     }
 }
 
+void outfmt_notice(const char *text)
+{
+    struct strbuf *sb = &outfmt_strbuf;
+    struct outfmt_s *ofd = &outfmt_data;
+
+    // received data only
+    if (_outfmt_opts.raw_out || jsonl_is_enabled() || hexdump_is_enabled())
+        return;
+
+    // pending (filtered) line, if any, stays after notice
+    outfmt_strbuf_flush(sb);
+    const bool interrupted =
+        ofd->last_c_flushed && ofd->last_c_flushed != '\n';
+    if (interrupted)
+        shell_write(STDOUT_FILENO, "\n", 1);
+
+    _notice_write("%s", text);
+
+    // rest of interrupted line on a new line, i.e. with timestamp
+    if (interrupted && ofd->line != OUTFMT_LINE_PENDING)
+        ofd->had_eol = true;
+}
+
 void outfmt_endline(void)
 {
     // TODO if color turn it off
     struct strbuf *sb = &outfmt_strbuf;
     struct outfmt_s *ofd = &outfmt_data;
+
+    // data as is, no newline added
+    if (_outfmt_opts.raw_out)
+        return;
+
     // flush in case data remains
+    hexdump_flush();
+    jsonl_flush();
+    _line_decide(sb, false);
+    _notices_write(sb);
     outfmt_strbuf_flush(sb);
     if (ofd->last_c_flushed == '\0') {
         return;
@@ -258,6 +840,37 @@ void outfmt_endline(void)
 }
 
 
+void outfmt_init(void)
+{
+    struct outfmt_s *ofd = &outfmt_data;
+
+    if (_outfmt_opts.raw_out) {
+        if (_outfmt_opts.timestamp || _outfmt_opts.color || _outfmt_opts.dedup
+            || _outfmt_opts.rate_limit > 0.0f || linefilt_is_enabled()
+            || hexdump_is_enabled() || jsonl_is_enabled())
+            LOG_WRN("output format options ignored with --raw-out");
+        return;
+    }
+
+    // filter need complete lines
+    if (linefilt_is_enabled() || _outfmt_opts.dedup
+        || _outfmt_opts.rate_limit > 0.0f) {
+        ofd->filter = true;
+        ofd->linebufed = true;
+    }
+
+    if (_outfmt_opts.rate_limit > 0.0f) {
+        if (_outfmt_opts.rate_burst < 1)
+            _outfmt_opts.rate_burst = _outfmt_opts.rate_limit + 1.0f;
+
+        ofd->tokens = _outfmt_opts.rate_burst;
+        ofd->tokens_ts = uv_now(uv_default_loop());
+    }
+
+    if (ofd->linebufed)
+        _eol_rx_timeout_init();
+}
+
 static int parse_timestamp_format(const struct opt_conf *conf, char *sval)
 {
     return -1;
@@ -291,12 +904,42 @@ static const struct opt_conf outfmt_opts_conf[] = {
         .descr = "ISO 8601 format for timestamp",
     },
 #endif
+    {
+        .name = "raw-out",
+        .dest = &_outfmt_opts.raw_out,
+        .parse = opt_parse_flag_true,
+        .descr = "write received data to stdout as is, without any "
+                 "formatting, e.g. `spcom --raw-out PORT > dump.bin`",
+    },
     {
         .name = "color",
         .dest = &_outfmt_opts.color,
         .parse = opt_parse_flag_true,
         .descr = "enable color output",
     },
+    {
+        .name = "dedup",
+        .dest = &_outfmt_opts.dedup,
+        .parse = opt_parse_flag_true,
+        .descr = "collapse consecutive identical received lines into "
+                 "\"last line repeated N times\". Capture file not affected",
+    },
+    {
+        .name = "rate-limit",
+        .dest = &_outfmt_opts.rate_limit,
+        .parse = opt_parse_float,
+        .metavar = "LINES",
+        .descr = "max received lines per second to show. Suppressed lines "
+                 "counted and reported. Capture file not affected",
+    },
+    {
+        .name = "rate-burst",
+        .dest = &_outfmt_opts.rate_burst,
+        .parse = opt_parse_int,
+        .metavar = "LINES",
+        .descr = "lines allowed in a burst with --rate-limit. "
+                 "Default: rate-limit + 1",
+    },
 #if CONFIG_EOL_RX_TIMEOUT
     {
         .name = "eol-rx-timeout",
@@ -3,28 +3,57 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h> // access
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h> // serial_icounter_struct
+#endif
 
 #include <libserialport.h>
 #include <uv.h>
 
 #include "assert.h"
+#include "capture.h"
 #include "cmd.h"
 #include "common.h"
 #include "eol.h"
+#include "expect.h"
+#include "jsonl.h"
 #include "log.h"
 #include "misc.h"
+#include "modem.h"
 #include "opq.h"
+#include "outfmt.h"
 #include "opt.h"
 #include "port.h"
+#include "port_io.h"
 #include "port_opts.h"
+#include "port_thread.h"
 #include "port_wait.h"
+#include "probe.h"
+#include "stats.h"
 #include "str.h"
+#include "trace.h"
+
+/// read size. large enough for a full tty buffer in one read
+#define PORT_RDBUF_SIZE 4096
+
+#if defined(__linux__) && defined(TIOCGICOUNT)
+#define PORT_HAVE_ICOUNT 1
+#else
+#define PORT_HAVE_ICOUNT 0
+#endif
+
+/// kernel UART counters poll interval
+#define PORT_ICOUNT_MS 1000
 
 #if 1
 static char __log_txrx_data[64];
 
 #define __LOG_TXRX(TX_OR_RX, DATA, SIZE)                                       \
     do {                                                                       \
+        /* escape only if logged */                                           \
+        if (!log_is_enabled(LOG_LEVEL_DBG))                                    \
+            break;                                                             \
         unsigned int _size = SIZE;                                             \
         str_escape_nonprint(__log_txrx_data, sizeof(__log_txrx_data), DATA,    \
                             _size);                                            \
@@ -57,23 +86,34 @@ enum port_state_e {
 
 static struct port_s {
     struct sp_port *port;
+    /// of `port`, see port_io.h
+    int fd;
     struct sp_port_config *usr_config;
     struct sp_port_config *org_config;
     bool have_org_config;
     uv_poll_t poll_handle;
     uv_prepare_t prepare_handle;
     uv_timer_t t_sleep;
+    uv_timer_t t_icount;
+    /// counters at last poll
+    unsigned int icount[PORT_ICOUNT_COUNT];
     uint64_t ts_lastc;
+    /// uv_hrtime() when port lost, zero if never open
+    uint64_t ts_lost;
     size_t offset;
     struct opq_item *current_op;
     enum port_state_e state;
+    /// UV_READABLE, or zero if read on port thread
+    int rd_events;
     port_rx_cb_fn *rx_cb;
     char eol[3];
     unsigned char eol_len;
+    struct port_stats_s stats;
 } port_data = { 0 };
 
 static void port_open(void);
 void port_close(void);
+static int port_set_config_op(const struct opq_item *op);
 void port_cleanup(void);
 static void _uvcb_poll_event(uv_poll_t *handle, int status, int events);
 
@@ -92,6 +132,111 @@ static const char *port_state_to_str(int state)
     }
 }
 
+static const char *port_icount_strs[PORT_ICOUNT_COUNT] = {
+    [PORT_ICOUNT_RX] = "rx",
+    [PORT_ICOUNT_TX] = "tx",
+    [PORT_ICOUNT_FRAME] = "frame",
+    [PORT_ICOUNT_OVERRUN] = "overrun",
+    [PORT_ICOUNT_PARITY] = "parity",
+    [PORT_ICOUNT_BRK] = "break",
+    [PORT_ICOUNT_BUF_OVERRUN] = "buf_overrun",
+};
+
+const char *port_icount_str(enum port_icount idx)
+{
+    assert(idx < PORT_ICOUNT_COUNT);
+    return port_icount_strs[idx];
+}
+
+/// @return false if not supported, e.g. pty or usb device without counters
+static bool _icount_read(unsigned int *icount)
+{
+#if PORT_HAVE_ICOUNT
+    struct serial_icounter_struct sic;
+    uv_os_fd_t fd = -1;
+
+    if (sp_get_port_handle(port_data.port, &fd) != SP_OK)
+        return false;
+
+    if (ioctl(fd, TIOCGICOUNT, &sic) < 0) {
+        LOG_DBG("TIOCGICOUNT %s", strerrorname_np(errno));
+        errno = 0;
+        return false;
+    }
+
+    icount[PORT_ICOUNT_RX] = sic.rx;
+    icount[PORT_ICOUNT_TX] = sic.tx;
+    icount[PORT_ICOUNT_FRAME] = sic.frame;
+    icount[PORT_ICOUNT_OVERRUN] = sic.overrun;
+    icount[PORT_ICOUNT_PARITY] = sic.parity;
+    icount[PORT_ICOUNT_BRK] = sic.brk;
+    icount[PORT_ICOUNT_BUF_OVERRUN] = sic.buf_overrun;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// add deltas since last poll. errors shown as event if any
+static void _icount_poll(void)
+{
+    struct port_s *p = &port_data;
+    unsigned int icount[PORT_ICOUNT_COUNT];
+    unsigned int delta[PORT_ICOUNT_COUNT];
+    unsigned int nerrors = 0;
+
+    if (!_icount_read(icount))
+        return;
+
+    for (int i = 0; i < PORT_ICOUNT_COUNT; i++) {
+        // unsigned, i.e. wrap ok
+        delta[i] = icount[i] - p->icount[i];
+        p->icount[i] = icount[i];
+        p->stats.icount[i] += delta[i];
+        if (i >= PORT_ICOUNT_FRAME)
+            nerrors += delta[i];
+    }
+
+    if (!nerrors)
+        return;
+
+    char text[128] = "UART errors:";
+    size_t len = strlen(text);
+    for (int i = PORT_ICOUNT_FRAME; i < PORT_ICOUNT_COUNT; i++) {
+        if (delta[i] && len < sizeof(text))
+            len += snprintf(&text[len], sizeof(text) - len, " %s %u",
+                            port_icount_strs[i], delta[i]);
+    }
+
+    LOG_DBG("%s", text);
+    capture_event(CAPTURE_TAG_EVT, "%s", text);
+    if (port_opts->mark_errors)
+        outfmt_notice(text);
+}
+
+static void _on_icount_timer(uv_timer_t *handle)
+{
+    _icount_poll();
+}
+
+/// baseline at open. counters are per device, since driver loaded
+static void _icount_start(void)
+{
+    struct port_s *p = &port_data;
+
+    if (!_icount_read(p->icount)) {
+        LOG_DBG("no kernel UART counters for '%s'", port_opts->name);
+        if (port_opts->mark_errors)
+            LOG_WRN("--mark-errors not supported by '%s'", port_opts->name);
+        return;
+    }
+
+    p->stats.have_icount = true;
+    int err = uv_timer_start(&p->t_icount, _on_icount_timer, PORT_ICOUNT_MS,
+                             PORT_ICOUNT_MS);
+    assert_uv_ok(err, "uv_timer_start");
+}
+
 static int _port_exists(void)
 {
     // wont fly on windows but uv_fs_pool_t doesent either (I think) so need
@@ -102,6 +247,7 @@ static int _port_exists(void)
 
 static void _on_port_discovered(int err)
 {
+    PROBE1(port_discovered, err);
     /* unless someting immediately received from port, user will never know if
      * device (re)connected */
     LOG_INF("Opening %s", port_opts->name);
@@ -111,6 +257,7 @@ static void _on_port_discovered(int err)
 static void _wait_start(void)
 {
     LOG_INF("Waiting for %s ...", port_opts->name);
+    PROBE1(port_wait_start, port_opts->name);
     port_wait_start(_on_port_discovered);
     port_data.state = PORT_STATE_WAITING;
 }
@@ -128,6 +275,7 @@ static void _port_panic_recover(void)
     /* if we get here, device probably still "exists" as this process holds a
      * open file descriptor to it . i.e. device not "gone" until after close.*/
     port_close();
+    port_data.ts_lost = uv_hrtime();
     _wait_start();
 }
 
@@ -157,24 +305,42 @@ static void _set_event_flags(int flags)
 static inline void _tx_start(void)
 {
     // always intereseted in read event
-    _set_event_flags(UV_READABLE | UV_WRITABLE);
+    _set_event_flags(port_data.rd_events | UV_WRITABLE);
 }
 
 static inline void _tx_stop(void)
 {
     // always intereseted in read event but not writable
-    _set_event_flags(UV_READABLE);
+    _set_event_flags(port_data.rd_events);
 }
 
-static void op_done(struct opq_item *op)
+/// release without op->done set, i.e. not executed
+static void op_release(struct opq_item *op)
 {
     opq_release_head(&opq_rt, op);
     port_data.offset = 0;
     port_data.current_op = NULL;
 }
 
+static void op_done(struct opq_item *op)
+{
+    PROBE2(op_done, op->op_code, op->ts);
+    if (op->op_code <= OP_PORT_PUT_EOL)
+        stats_hist_add(&stats.tx_latency, uv_hrtime() - op->ts);
+    op->done = true;
+    op_release(op);
+}
+
+static void _on_expect_done(void)
+{
+    assert(port_data.current_op);
+    assert(port_data.current_op->op_code == OP_EXPECT);
+    op_done(port_data.current_op);
+}
+
 static void _on_sleep_done(uv_timer_t *handle)
 {
+    TRACE(TRACE_TIMER, TRACE_TIMER_PORT_SLEEP);
     LOG_DBG("op d sleep done");
     assert(port_data.current_op);
     assert(port_data.current_op->op_code == OP_SLEEP);
@@ -213,7 +379,7 @@ static bool update_write(const void *buf, size_t bufsize)
         size = remains;
     }
 
-    rc = sp_nonblocking_write(p->port, src, size);
+    rc = port_io_write(p->port, p->fd, src, size);
 
     if (rc < 0) {
         PORT_PANIC(EX_IOERR, "port write - %s", misc_sp_err_to_str(rc));
@@ -222,7 +388,10 @@ static bool update_write(const void *buf, size_t bufsize)
 
     if (rc == 0) {
         // i.e. EAGAIN retry on next writable event
-        LOG_DBG("sp_nonblocking_write rc=0 (EAGAIN?");
+        TRACE(TRACE_PORT_EAGAIN, 1);
+        PROBE1(port_eagain, 1);
+        stats.tx_eagain++;
+        LOG_DBG("port write rc=0 (EAGAIN?)");
         return false;
     }
 
@@ -230,7 +399,17 @@ static bool update_write(const void *buf, size_t bufsize)
         p->ts_lastc = ts_now;
     }
 
-    __LOG_TXRX("TX", src, size);
+    TRACE(TRACE_PORT_WRITE, rc);
+    PROBE1(port_write, rc);
+    stats.tx_writes++;
+    __LOG_TXRX("TX", src, rc);
+    // forwarded, e.g. by sniff, captured on receive. same as port_write()
+    if (!p->current_op->forwarded) {
+        capture_data(CAPTURE_TAG_TX, src, rc);
+        if (jsonl_is_enabled())
+            jsonl_write(JSONL_DIR_TX, src, rc);
+    }
+    port_data.stats.tx_bytes += rc;
 
     if (rc < remains) {
         // incomplete write. try write remaining on next writable event
@@ -261,9 +440,15 @@ static void _on_prepare(uv_prepare_t *handle)
 
     // load/start operation prior sleep timer start
     port_data.current_op = op;
-    // OP_EXIT is the only accepted op_code when port not ready
+    // OP_EXIT and OP_NOTIFY are the only accepted op_codes when port not ready
     if (op->op_code == OP_EXIT) {
-        SPCOM_EXIT(EX_OK, "op exit");
+        SPCOM_EXIT(op->u.val, "op exit");
+        return;
+    }
+
+    if (op->op_code == OP_NOTIFY) {
+        // i.e. all prior ops done. notify by free_cb
+        op_done(op);
         return;
     }
 
@@ -272,20 +457,26 @@ static void _on_prepare(uv_prepare_t *handle)
                 port_state_to_str(port_data.state));
 
         // implicilty set port_data.current_op = NULL;
-        op_done(op);
+        op_release(op);
         return;
     }
 
     if (op->op_code == OP_SLEEP) {
         // if (port_data.sleep_active) {
         // uv_timer_get_due_in
-        uint64_t ms = (uint64_t)op->u.val * 1000;
+        uint64_t ms = op->u.val;
         int err = uv_timer_start(&port_data.t_sleep, _on_sleep_done, ms, 0);
         LOG_DBG("sleeping %d ms", (unsigned int)ms);
         assert_uv_ok(err, "uv_timer_start");
         return;
     }
 
+    if (op->op_code == OP_EXPECT) {
+        // might complete immediately
+        expect_start(op->u.data, _on_expect_done);
+        return;
+    }
+
     _tx_start(); // enable _on_writable()
 }
 
@@ -344,6 +535,26 @@ static void _on_writable(uv_poll_t *handle)
             done = true;
             break;
 
+        case OP_PORT_BAUD:
+        case OP_PORT_DATABITS:
+        case OP_PORT_PARITY:
+        case OP_PORT_STOPBITS:
+        case OP_PORT_FLOW:
+            // errors already logged
+            port_set_config_op(op);
+            done = true;
+            break;
+
+        case OP_PORT_BREAK:
+            if (op->u.val)
+                err = sp_start_break(port_data.port);
+            else
+                err = sp_end_break(port_data.port);
+            if (err)
+                LOG_SP_ERR(err, "sp_{start,end}_break");
+            done = true;
+            break;
+
         case OP_PORT_DRAIN:
             // TODO is this "safe"? see libserialport doc.
             err = sp_drain(port_data.port);
@@ -353,14 +564,15 @@ static void _on_writable(uv_poll_t *handle)
             break;
 
         case OP_PORT_FLUSH:
-            // TODO always flush IO?
-            err = sp_flush(port_data.port, SP_BUF_BOTH);
+            // value is SP_BUF_{INPUT,OUTPUT,BOTH}. zero is both
+            err = sp_flush(port_data.port, op->u.val ? op->u.val : SP_BUF_BOTH);
             if (err)
                 LOG_SP_ERR(err, "sp_flush");
             done = true;
             break;
 
         case OP_SLEEP:
+        case OP_EXPECT:
         case OP_EXIT:
             done = false;
             break;
@@ -376,17 +588,36 @@ static void _on_writable(uv_poll_t *handle)
     }
 }
 
+/// read from loop or port thread. `ts` is uv_hrtime() of read
+static void _on_rx(const void *data, size_t size, uint64_t ts)
+{
+    PROBE1(port_read, size);
+    stats.rx_reads++;
+    stats_hist_add(&stats.read_size, size);
+    __LOG_TXRX("RX", data, size);
+    port_data.stats.rx_bytes += size;
+    port_data.stats.rx_time = ts;
+    port_data.rx_cb(data, size);
+}
+
+static void _on_thread_err(int err)
+{
+    PORT_PANIC(EX_IOERR, "port read - %s", misc_sp_err_to_str(err));
+}
+
 static void _on_readable(uv_poll_t *handle)
 {
-    // TODO bufsize?
-    static char buf[255];
-    int rc = sp_nonblocking_read(port_data.port, buf, sizeof(buf));
+    static char buf[PORT_RDBUF_SIZE];
+    int rc = port_io_read(port_data.port, port_data.fd, buf, sizeof(buf));
     if (rc < 0) {
         PORT_PANIC(EX_IOERR, "port read - %s", misc_sp_err_to_str(rc));
         return;
     }
     if (rc == 0) {
-        LOG_DBG("sp_nonblocking_read rc=0 (EAGAIN)");
+        TRACE(TRACE_PORT_EAGAIN, 0);
+        PROBE1(port_eagain, 0);
+        stats.rx_eagain++;
+        LOG_DBG("port read rc=0 (EAGAIN)");
         // Try again later
         return;
     }
@@ -395,9 +626,8 @@ static void _on_readable(uv_poll_t *handle)
         LOG_DBG("read=buf_size");
     }
 
-    size_t size = rc;
-    __LOG_TXRX("RX", buf, size);
-    port_data.rx_cb(buf, size);
+    TRACE(TRACE_PORT_READ, rc);
+    _on_rx(buf, rc, uv_hrtime());
 }
 
 /*
@@ -422,6 +652,7 @@ static void _uvcb_poll_event(uv_poll_t *handle, int status, int events)
         LOG_WRN("unexpected uv poll status %d", status);
     }
     // LOG_DBG("port event. status=%d, event_flags=0x%x", status, events);
+    TRACE(TRACE_PORT_POLL, events);
     if (events & UV_READABLE) {
         _on_readable(handle);
     }
@@ -436,48 +667,47 @@ static void _uvcb_poll_event(uv_poll_t *handle, int status, int events)
     }
 }
 
-int port_set_config(void)
+int port_apply_config(struct sp_port *p, const struct port_opts_s *cfg)
 {
     int err;
 #define CONFIG_ERROR(ERR, WHY) (LOG_SP_ERR(ERR, WHY), ERR)
-    struct sp_port *p = port_data.port;
     if (!p)
         return -1;
 
-    if (port_opts->baudrate >= 0) {
-        err = sp_set_baudrate(p, port_opts->baudrate);
+    if (cfg->baudrate >= 0) {
+        err = sp_set_baudrate(p, cfg->baudrate);
         if (err)
             return CONFIG_ERROR(err, "sp_set_baudrate");
     }
 
-    if (port_opts->databits >= 0) {
-        err = sp_set_bits(p, port_opts->databits);
+    if (cfg->databits >= 0) {
+        err = sp_set_bits(p, cfg->databits);
         if (err)
             return CONFIG_ERROR(err, "sp_set_(data)bits");
     }
 
-    if (port_opts->parity >= 0) {
-        err = sp_set_parity(p, port_opts->parity);
+    if (cfg->parity >= 0) {
+        err = sp_set_parity(p, cfg->parity);
         if (err)
             return CONFIG_ERROR(err, "sp_set_parity");
     }
 
-    if (port_opts->stopbits >= 0) {
-        err = sp_set_stopbits(p, port_opts->stopbits);
+    if (cfg->stopbits >= 0) {
+        err = sp_set_stopbits(p, cfg->stopbits);
         if (err)
             return CONFIG_ERROR(err, "sp_set_stopbits");
     }
 
-    if (port_opts->flowcontrol >= 0) {
+    if (cfg->flowcontrol >= 0) {
 
-        int flowcontrol = FLOW_TO_SP_FLOWCONTROL(port_opts->flowcontrol);
+        int flowcontrol = FLOW_TO_SP_FLOWCONTROL(cfg->flowcontrol);
         err = sp_set_flowcontrol(p, flowcontrol);
         if (err)
             return CONFIG_ERROR(err, "sp_set_flowcontrol");
 
         // libserialport default when flow is XONOFF is txrx
         if (flowcontrol == SP_FLOWCONTROL_XONXOFF) {
-            int xonxoff = FLOW_TO_SP_XONXOFF(port_opts->flowcontrol);
+            int xonxoff = FLOW_TO_SP_XONXOFF(cfg->flowcontrol);
             if (xonxoff) {
                 err = sp_set_xon_xoff(p, xonxoff);
                 if (err)
@@ -485,7 +715,55 @@ int port_set_config(void)
             }
         }
     }
+#undef CONFIG_ERROR
+    return 0;
+}
+
+int port_set_config(void)
+{
+    return port_apply_config(port_data.port, port_opts);
+}
+
+/// runtime change of a single config value, i.e. OP_PORT_{BAUD, PARITY,...}
+static int port_set_config_op(const struct opq_item *op)
+{
+    // negative values left untouched
+    struct port_opts_s cfg = {
+        .baudrate = -1,
+        .databits = -1,
+        .stopbits = -1,
+        .parity = -1,
+        .flowcontrol = -1,
+    };
+
+    switch (op->op_code) {
+        case OP_PORT_BAUD:
+            cfg.baudrate = op->u.val;
+            break;
+        case OP_PORT_DATABITS:
+            cfg.databits = op->u.val;
+            break;
+        case OP_PORT_PARITY:
+            cfg.parity = op->u.val;
+            break;
+        case OP_PORT_STOPBITS:
+            cfg.stopbits = op->u.val;
+            break;
+        case OP_PORT_FLOW:
+            cfg.flowcontrol = op->u.val;
+            break;
+        default:
+            assert(0);
+            return -1;
+    }
+
+    LOG_DBG("set config op %d = %d", op->op_code, op->u.val);
+    int err = port_apply_config(port_data.port, &cfg);
+    if (err)
+        return err;
 
+    // else port_set_config() restores command line values on reconnect
+    port_opts_update_config(&cfg);
     return 0;
 }
 
@@ -522,6 +800,7 @@ static void port_open(void)
     uv_os_fd_t fd = -1; // or uv_file ?
     err = sp_get_port_handle(p, &fd);
     assert_sp_ok(err, "sp_get_port_handle");
+    port_data.fd = fd;
 
     // saftey check
     uv_handle_type htype = uv_guess_handle(fd);
@@ -538,11 +817,33 @@ static void port_open(void)
     err = uv_poll_init(loop, &port_data.poll_handle, fd);
     assert_uv_ok(err, "uv_poll_init");
 
-    int events = UV_READABLE | UV_WRITABLE;
+    port_data.rd_events = port_thread_is_enabled() ? 0 : UV_READABLE;
+    int events = port_data.rd_events | UV_WRITABLE;
     err = uv_poll_start(&port_data.poll_handle, events, _uvcb_poll_event);
     assert_uv_ok(err, "uv_poll_start");
 
+    if (port_thread_is_enabled())
+        port_thread_start(p, fd);
+
     port_data.state = PORT_STATE_READY;
+    PROBE1(port_open, port_opts->name);
+
+    _icount_start();
+    modem_start(fd);
+
+    if (port_data.ts_lost) {
+        uint64_t dt = uv_hrtime() - port_data.ts_lost;
+        stats.reconnects++;
+        stats.disconnected_ns += dt;
+        if (dt > stats.disconnected_max_ns)
+            stats.disconnected_max_ns = dt;
+        port_data.ts_lost = 0;
+    }
+
+    /* startup commands, i.e. `--cmd` and `--expect`. moved, so only run on
+     * first open. remaining ones (if any) on next open */
+    if (opq_transfer(&opq_rt, &opq_oo))
+        LOG_WRN("queue full. too many startup commands");
 }
 
 void port_close(void)
@@ -553,9 +854,22 @@ void port_close(void)
         return;
     }
 
+    PROBE1(port_close, port_opts->name);
+
     err = uv_timer_stop(&port_data.t_sleep);
     (void)err;
 
+    // threads use fd
+    port_thread_stop();
+    modem_stop();
+
+    // last deltas. fails silently if device gone
+    if (uv_is_active((uv_handle_t *)&port_data.t_icount)) {
+        _icount_poll();
+        err = uv_timer_stop(&port_data.t_icount);
+        (void)err;
+    }
+
     err = uv_prepare_stop(&port_data.prepare_handle);
     (void)err; // cant fail
 
@@ -593,6 +907,8 @@ void port_close(void)
 
 void port_cleanup(void)
 {
+    port_thread_cleanup();
+
     if (port_data.org_config) {
         sp_free_config(port_data.org_config);
         port_data.org_config = NULL;
@@ -603,49 +919,37 @@ void port_cleanup(void)
 
 int port_write(const void *data, size_t size)
 {
-#if 1
-    return -1;
-#else
-    /* TODO I think there is a good reason for not
-     * calling sp_nonblocking_write() directly here but I forgot if or why */
+    /* note: bypasses opq, i.e. not ordered with queued writes and chardelay
+     * not applied. intended for forwarding where latency matters */
 
-    if (!port_data.port)
+    if (!port_data.port || port_data.state != PORT_STATE_READY)
         return -1;
 
-    if (port_data.state != PORT_STATE_READY) {
-        LOG_ERR("%s not ready. state: %s", port_opts->name,
-                port_state_to_str(port_data.state));
-
+    int rc = port_io_write(port_data.port, port_data.fd, data, size);
+    if (rc < 0) {
+        PORT_PANIC(EX_IOERR, "port write - %s", misc_sp_err_to_str(rc));
         return -1;
     }
 
-    int remains = size;
-    const char *p = data;
-    while (remains > 0) {
-        int rc = sp_nonblocking_write(port_data.port, p, remains);
-
-        if (rc < 0) {
-            LOG_ERR("sp_nb_write rc=%d", rc);
-            port_panic(EX_IOERR, "write error");
-            return -1;
-        }
-        if (rc == 0) {
-            // i.e. EAGAIN retry on next writable event
-            LOG_DBG("sp_nb_write rc=0 (EAGAIN?");
-            continue;
-        }
-        if (rc < size) {
-            LOG_DBG("sp_nb_write %d/%zu", rc, size);
-            // incomplete write. try write remaining on next writable event
-            p += rc;
-            remains -= rc;
-        }
-        assert(rc == size);
-        break;
+    if (rc > 0) {
+        TRACE(TRACE_PORT_WRITE, rc);
+        PROBE1(port_write, rc);
+        stats.tx_writes++;
+        __LOG_TXRX("TX", data, rc);
+        port_data.stats.tx_bytes += rc;
     }
 
-    return 0;
-#endif
+    return rc;
+}
+
+const char *port_state_str(void)
+{
+    return port_state_to_str(port_data.state);
+}
+
+const struct port_stats_s *port_stats(void)
+{
+    return &port_data.stats;
 }
 
 int port_putc(int c)
@@ -709,6 +1013,7 @@ void port_init(port_rx_cb_fn *rx_cb)
                                     sizeof(port_data.eol));
 
     port_data.rx_cb = rx_cb;
+    port_thread_init(_on_rx, _on_thread_err);
     // allocate some resources
     err = sp_new_config(&port_data.org_config);
     assert_sp_ok(err, "sp_new_config");
@@ -719,6 +1024,9 @@ void port_init(port_rx_cb_fn *rx_cb)
     err = uv_timer_init(loop, &port_data.t_sleep);
     assert_uv_ok(err, "uv_timer_init");
 
+    err = uv_timer_init(loop, &port_data.t_icount);
+    assert_uv_ok(err, "uv_timer_init");
+
     port_data.ts_lastc = uv_now(loop);
 
     if (port_opts->wait) {
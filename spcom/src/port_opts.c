@@ -32,6 +32,20 @@ static struct port_opts_s _port_opts = {
 // exposed const "read" pointer
 const struct port_opts_s *port_opts = &_port_opts;
 
+void port_opts_update_config(const struct port_opts_s *cfg)
+{
+    if (cfg->baudrate >= 0)
+        _port_opts.baudrate = cfg->baudrate;
+    if (cfg->databits >= 0)
+        _port_opts.databits = cfg->databits;
+    if (cfg->parity >= 0)
+        _port_opts.parity = cfg->parity;
+    if (cfg->stopbits >= 0)
+        _port_opts.stopbits = cfg->stopbits;
+    if (cfg->flowcontrol >= 0)
+        _port_opts.flowcontrol = cfg->flowcontrol;
+}
+
 // clang-format off
 static const char* pinstate_words[] =  {
    "0",   "1",
@@ -460,6 +474,22 @@ static const struct opt_conf port_opts_conf[] = {
         .descr = "Similar to --wait but will never exit if the serial port "
                  "disappears and wait for it to reappear instead"
     },
+    {
+        .name = "mark-errors",
+        .dest = &_port_opts.mark_errors,
+        .parse = opt_parse_flag_true,
+        .descr = "show a notice in output when the kernel reports UART "
+                 "overrun, framing or parity errors, or break. Polled once "
+                 "per second, i.e. position in output is approximate"
+    },
+    {
+        .name = "direct-io",
+        .dest = &_port_opts.direct_io,
+        .parse = opt_parse_flag_true,
+        .descr = "read and write port with plain read(2) and write(2), "
+                 "bypassing libserialport, e.g. at high baudrates. Port "
+                 "config still by libserialport"
+    },
 };
 
 OPT_SECTION_ADD(port,
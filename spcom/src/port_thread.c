@@ -0,0 +1,329 @@
+/**
+ * port reads on a dedicated thread, i.e. a slow terminal or formatting does
+ * not delay the next read, and so do not overrun the UART. Enabled with
+ * `--io-thread`.
+ *
+ * The thread polls the port fd and reads directly into a single-producer,
+ * single-consumer byte ring, i.e. each read takes only the bytes received.
+ * Per read a timestamp and length go to a second ring, so the loop still sees
+ * reads as they were, e.g. for `--frame gap`. The event loop is woken with
+ * uv_async, which coalesces wake ups, and takes the reads available per wake
+ * up. No locks, only the ring indices are shared.
+ *
+ * Writes stay on the event loop. They are ordered with other queued
+ * operations (sleep, expect, config) and never block.
+ *
+ * The ring holds 1 MiB, ~3.5 s at 3 Mbaud, or 16384 reads, whichever is
+ * reached first. If full, i.e. the loop stalled for longer, reads pause and
+ * data is left in the kernel buffer.
+ */
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+// deps
+#include <libserialport.h>
+#include <uv.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "log.h"
+#include "opt.h"
+#include "port_io.h"
+#include "port_thread.h"
+#include "realtime.h"
+#include "stats.h"
+#include "trace.h"
+
+/// max bytes per read, same as read size on loop
+#define PORT_THREAD_READ_MAX 4096
+/// bytes in ring. power of two
+#define PORT_THREAD_RING_SIZE (1024 * 1024)
+/// reads in ring. power of two
+#define PORT_THREAD_READS_LEN 16384
+/// reads handled per wake up, so terminal input not starved
+#define PORT_THREAD_BATCH_MAX 64
+/// wait for space when ring full
+#define PORT_THREAD_FULL_WAIT_MS 1
+
+struct port_thread_read {
+    uint64_t ts;
+    /// bytes in ring or negative libserialport error
+    int len;
+};
+
+static struct port_thread_opts_s {
+    int enable;
+} port_thread_opts;
+
+static struct port_thread_s {
+    bool initialized;
+    bool running;
+    struct sp_port *port;
+    int fd;
+    /// eventfd. stop request
+    int wake_fd;
+    pthread_t thread;
+    uv_async_t async;
+    port_thread_rx_fn *rx_cb;
+    port_thread_err_fn *err_cb;
+    /// --realtime result of thread, logged by loop
+    struct realtime_status rt;
+    bool rt_ready;
+    bool rt_logged;
+    char *ring;
+    struct port_thread_read *reads;
+    /// byte head of ring. thread only, published with head
+    unsigned int ring_head;
+    /// reads. written by thread only. own cache line, i.e. no false sharing
+    unsigned int head __attribute__((aligned(64)));
+    /// reads and byte tail of ring. written by loop only
+    unsigned int tail __attribute__((aligned(64)));
+    unsigned int ring_tail;
+} port_thread_data;
+
+bool port_thread_is_enabled(void)
+{
+    return port_thread_opts.enable;
+}
+
+static inline void _publish(struct port_thread_s *pt, unsigned int head)
+{
+    __atomic_store_n(&pt->head, head + 1, __ATOMIC_RELEASE);
+    uv_async_send(&pt->async);
+}
+
+/// @return bytes next read can take, contiguous in ring. 0 if full
+static size_t _read_space(const struct port_thread_s *pt, unsigned int head)
+{
+    unsigned int tail = __atomic_load_n(&pt->tail, __ATOMIC_ACQUIRE);
+    unsigned int ring_tail = __atomic_load_n(&pt->ring_tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail == PORT_THREAD_READS_LEN)
+        return 0;
+
+    size_t space = PORT_THREAD_RING_SIZE - (pt->ring_head - ring_tail);
+    size_t to_end =
+        PORT_THREAD_RING_SIZE - (pt->ring_head & (PORT_THREAD_RING_SIZE - 1));
+
+    if (space > to_end)
+        space = to_end;
+    return space < PORT_THREAD_READ_MAX ? space : PORT_THREAD_READ_MAX;
+}
+
+/// @return false if stop requested
+static bool _wait_space(struct port_thread_s *pt)
+{
+    struct pollfd pfd = { .fd = pt->wake_fd, .events = POLLIN };
+
+    return poll(&pfd, 1, PORT_THREAD_FULL_WAIT_MS) == 0;
+}
+
+static void *_thread(void *arg)
+{
+    struct port_thread_s *pt = &port_thread_data;
+
+    if (realtime_thread_init(&pt->rt)) {
+        __atomic_store_n(&pt->rt_ready, true, __ATOMIC_RELEASE);
+        uv_async_send(&pt->async);
+    }
+
+    bool full = false;
+
+    for (;;) {
+        unsigned int head = pt->head;
+        size_t space = _read_space(pt, head);
+
+        if (!space) {
+            // once per stall, not per wait
+            if (!full)
+                stats_add_atomic(&stats.rx_ring_full, 1);
+            full = true;
+            if (!_wait_space(pt))
+                break;
+            continue;
+        }
+        full = false;
+
+        struct pollfd pfd[] = {
+            { .fd = pt->fd, .events = POLLIN },
+            { .fd = pt->wake_fd, .events = POLLIN },
+        };
+
+        int rc = poll(pfd, ARRAY_LEN(pfd), -1);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc < 0 || pfd[1].revents)
+            break;
+
+        struct port_thread_read *r =
+            &pt->reads[head & (PORT_THREAD_READS_LEN - 1)];
+        char *data = &pt->ring[pt->ring_head & (PORT_THREAD_RING_SIZE - 1)];
+
+        r->len = port_io_read(pt->port, pt->fd, data, space);
+        if (r->len == 0) {
+            if (!(pfd[0].revents & (POLLHUP | POLLERR | POLLNVAL))) {
+                TRACE(TRACE_PORT_EAGAIN, 0);
+                stats_add_atomic(&stats.rx_eagain, 1);
+                continue;
+            }
+            // hangup and nothing to read, i.e. port gone
+            r->len = SP_ERR_FAIL;
+        }
+
+        r->ts = uv_hrtime();
+        TRACE(TRACE_PORT_READ, r->len);
+        if (r->len > 0)
+            pt->ring_head += r->len;
+        _publish(pt, head);
+
+        if (r->len < 0)
+            break;
+    }
+
+    return NULL;
+}
+
+static void _on_async(uv_async_t *handle)
+{
+    struct port_thread_s *pt = &port_thread_data;
+    unsigned int tail = pt->tail;
+    unsigned int ring_tail = pt->ring_tail;
+    unsigned int head = __atomic_load_n(&pt->head, __ATOMIC_ACQUIRE);
+    unsigned int n = 0;
+
+    // thread does not log, shell output not thread safe
+    if (!pt->rt_logged && __atomic_load_n(&pt->rt_ready, __ATOMIC_ACQUIRE)) {
+        realtime_log(&pt->rt);
+        pt->rt_logged = true;
+    }
+
+    for (; tail != head && n < PORT_THREAD_BATCH_MAX; tail++, n++) {
+        const struct port_thread_read *r =
+            &pt->reads[tail & (PORT_THREAD_READS_LEN - 1)];
+
+        if (r->len < 0) {
+            __atomic_store_n(&pt->tail, head, __ATOMIC_RELEASE);
+            pt->err_cb(r->len); // might stop thread
+            return;
+        }
+
+        pt->rx_cb(&pt->ring[ring_tail & (PORT_THREAD_RING_SIZE - 1)], r->len,
+                  r->ts);
+        ring_tail += r->len;
+        __atomic_store_n(&pt->ring_tail, ring_tail, __ATOMIC_RELEASE);
+        __atomic_store_n(&pt->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // more, after other events
+    if (tail != head)
+        uv_async_send(&pt->async);
+}
+
+void port_thread_start(struct sp_port *port, int fd)
+{
+    struct port_thread_s *pt = &port_thread_data;
+
+    assert(pt->initialized);
+    assert(!pt->running);
+
+    pt->port = port;
+    pt->fd = fd;
+    pt->head = 0;
+    pt->tail = 0;
+    pt->ring_head = 0;
+    pt->ring_tail = 0;
+    pt->rt_ready = false;
+    pt->rt_logged = false;
+
+    // realtime_thread_init() applied by thread itself
+    pthread_attr_t attr;
+    realtime_thread_attr_init(&attr);
+    int err = pthread_create(&pt->thread, &attr, _thread, NULL);
+    pthread_attr_destroy(&attr);
+    if (err)
+        SPCOM_EXIT(EX_OSERR, "port thread '%s'", strerror(err));
+
+    pt->running = true;
+}
+
+void port_thread_stop(void)
+{
+    struct port_thread_s *pt = &port_thread_data;
+    uint64_t one = 1;
+    uint64_t val;
+
+    if (!pt->running)
+        return;
+
+    ssize_t rc = write(pt->wake_fd, &one, sizeof(one));
+    (void)rc; // can not fail, counter far from max
+
+    pthread_join(pt->thread, NULL);
+    pt->running = false;
+
+    // reset for next start
+    rc = read(pt->wake_fd, &val, sizeof(val));
+    (void)rc;
+}
+
+void port_thread_init(port_thread_rx_fn *rx_cb, port_thread_err_fn *err_cb)
+{
+    struct port_thread_s *pt = &port_thread_data;
+
+    if (!port_thread_opts.enable)
+        return;
+
+    pt->rx_cb = rx_cb;
+    pt->err_cb = err_cb;
+
+    // before any --realtime mlockall, i.e. prefaulted
+    pt->ring = calloc(1, PORT_THREAD_RING_SIZE);
+    pt->reads = calloc(PORT_THREAD_READS_LEN, sizeof(*pt->reads));
+    assert(pt->ring && pt->reads);
+
+    pt->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (pt->wake_fd < 0)
+        SPCOM_EXIT(EX_OSERR, "eventfd '%s'", strerror(errno));
+
+    int err = uv_async_init(uv_default_loop(), &pt->async, _on_async);
+    assert_uv_ok(err, "uv_async_init");
+
+    pt->initialized = true;
+}
+
+void port_thread_cleanup(void)
+{
+    struct port_thread_s *pt = &port_thread_data;
+
+    if (!pt->initialized)
+        return;
+
+    port_thread_stop();
+    close(pt->wake_fd);
+    free(pt->ring);
+    free(pt->reads);
+    pt->ring = NULL;
+    pt->reads = NULL;
+    pt->initialized = false;
+}
+
+static const struct opt_conf port_thread_opts_conf[] = {
+    {
+        .name = "io-thread",
+        .dest = &port_thread_opts.enable,
+        .parse = opt_parse_flag_true,
+        .descr = "read port on a dedicated thread, i.e. a slow terminal does "
+                 "not delay reads. Buffers up to 1 MiB or 16384 reads",
+    },
+};
+
+OPT_SECTION_ADD(port_thread,
+                port_thread_opts_conf,
+                ARRAY_LEN(port_thread_opts_conf),
+                NULL);
@@ -0,0 +1,387 @@
+/**
+ * pty bridge - expose the serial port as a pseudo-terminal.
+ *
+ * master side is owned by spcom. A slave fd is kept open by spcom as well,
+ * otherwise reading master returns EIO every time the last external user
+ * closes the slave.
+ *
+ * Changes made to the pty termios (baudrate, parity etc.) by the external
+ * tool can optionally be applied to the serial port. There is no event for
+ * this so termios is polled at a low rate.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+// deps
+#include <libserialport.h>
+#include <uv.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "log.h"
+#include "opq.h"
+#include "opt.h"
+#include "port_opts.h"
+#include "pty_bridge.h"
+
+#define PTY_BRIDGE_RDBUF_SIZE 4096
+#define PTY_BRIDGE_TERMIOS_POLL_MS 100
+
+static struct pty_bridge_opts_s {
+    int enable;
+    int termios;
+} pty_bridge_opts;
+
+static struct pty_bridge_s {
+    bool initialized;
+    int master_fd;
+    int slave_fd;
+    uv_poll_t poll_handle;
+    uv_timer_t termios_timer;
+    bool have_termios;
+    struct termios termios;
+    /// data from pty enqueued but not yet written to serial port
+    bool write_pending;
+    /// bytes from serial port not written to pty, i.e. no one reading it
+    size_t dropped;
+} pty_bridge_data = {
+    .master_fd = -1,
+    .slave_fd = -1,
+};
+
+static const struct {
+    speed_t speed;
+    int baudrate;
+} pty_speed_map[] = {
+    // clang-format off
+    { B1200,    1200 },    { B1800,    1800 },    { B2400,    2400 },
+    { B4800,    4800 },    { B9600,    9600 },    { B19200,   19200 },
+    { B38400,   38400 },   { B57600,   57600 },   { B115200,  115200 },
+    { B230400,  230400 },  { B460800,  460800 },  { B500000,  500000 },
+    { B576000,  576000 },  { B921600,  921600 },  { B1000000, 1000000 },
+    { B1152000, 1152000 }, { B1500000, 1500000 }, { B2000000, 2000000 },
+    { B2500000, 2500000 }, { B3000000, 3000000 }, { B3500000, 3500000 },
+    { B4000000, 4000000 },
+    // clang-format on
+};
+
+static int _speed_to_baudrate(speed_t speed)
+{
+    for (int i = 0; i < ARRAY_LEN(pty_speed_map); i++) {
+        if (pty_speed_map[i].speed == speed)
+            return pty_speed_map[i].baudrate;
+    }
+
+    return -1;
+}
+
+static int _cflag_to_databits(tcflag_t cflag)
+{
+    switch (cflag & CSIZE) {
+        case CS5:
+            return 5;
+        case CS6:
+            return 6;
+        case CS7:
+            return 7;
+        default:
+            return 8;
+    }
+}
+
+static int _cflag_to_parity(tcflag_t cflag)
+{
+    if (!(cflag & PARENB))
+        return SP_PARITY_NONE;
+#ifdef CMSPAR
+    if (cflag & CMSPAR)
+        return (cflag & PARODD) ? SP_PARITY_MARK : SP_PARITY_SPACE;
+#endif
+    return (cflag & PARODD) ? SP_PARITY_ODD : SP_PARITY_EVEN;
+}
+
+static int _termios_to_flowcontrol(const struct termios *t)
+{
+#ifdef CRTSCTS
+    if (t->c_cflag & CRTSCTS)
+        return SP_FLOWCONTROL_RTSCTS;
+#endif
+    if (t->c_iflag & (IXON | IXOFF))
+        return SP_FLOWCONTROL_XONXOFF;
+
+    return SP_FLOWCONTROL_NONE;
+}
+
+static void _enqueue_op(uint16_t op_code, int val)
+{
+    if (!opq_acquire_tail(&opq_rt)) {
+        LOG_WRN("pty op %d dropped. queue full", op_code);
+        return;
+    }
+
+    opq_enqueue_val(&opq_rt, op_code, val);
+}
+
+/// compare new and old termios and enqueue changed port settings
+static void _termios_propagate(const struct termios *old,
+                               const struct termios *new)
+{
+    speed_t speed = cfgetospeed(new);
+    if (speed != cfgetospeed(old)) {
+        int baudrate = _speed_to_baudrate(speed);
+        if (baudrate > 0)
+            _enqueue_op(OP_PORT_BAUD, baudrate);
+        else
+            LOG_WRN("pty speed 0x%x not supported", (unsigned int)speed);
+    }
+
+    int databits = _cflag_to_databits(new->c_cflag);
+    if (databits != _cflag_to_databits(old->c_cflag))
+        _enqueue_op(OP_PORT_DATABITS, databits);
+
+    int parity = _cflag_to_parity(new->c_cflag);
+    if (parity != _cflag_to_parity(old->c_cflag))
+        _enqueue_op(OP_PORT_PARITY, parity);
+
+    if ((new->c_cflag & CSTOPB) != (old->c_cflag & CSTOPB))
+        _enqueue_op(OP_PORT_STOPBITS, (new->c_cflag & CSTOPB) ? 2 : 1);
+
+    int flow = _termios_to_flowcontrol(new);
+    if (flow != _termios_to_flowcontrol(old))
+        _enqueue_op(OP_PORT_FLOW, flow);
+}
+
+static void _on_termios_timer(uv_timer_t *handle)
+{
+    struct pty_bridge_s *pb = &pty_bridge_data;
+    struct termios t;
+
+    // on linux, termios of master is the same as slave
+    int err = tcgetattr(pb->master_fd, &t);
+    if (err) {
+        LOG_ERRNO(errno, "pty tcgetattr");
+        return;
+    }
+
+    if (pb->have_termios) {
+        if (!memcmp(&t, &pb->termios, sizeof(t)))
+            return;
+
+        LOG_DBG("pty termios changed");
+        _termios_propagate(&pb->termios, &t);
+    }
+
+    pb->termios = t;
+    pb->have_termios = true;
+}
+
+static void _poll_start(void);
+
+static void _on_port_write_done(const struct opq_item *itm)
+{
+    struct pty_bridge_s *pb = &pty_bridge_data;
+
+    assert(itm->u.data);
+    free(itm->u.data);
+
+    pb->write_pending = false;
+    if (pb->initialized)
+        _poll_start();
+}
+
+static void _on_master_readable(void)
+{
+    struct pty_bridge_s *pb = &pty_bridge_data;
+
+    // freed when written to serial port
+    char *buf = malloc(PTY_BRIDGE_RDBUF_SIZE);
+    assert(buf);
+
+    ssize_t rc = read(pb->master_fd, buf, PTY_BRIDGE_RDBUF_SIZE);
+    if (rc <= 0) {
+        free(buf);
+        // EIO should not occur as slave fd kept open
+        if (rc < 0 && errno != EAGAIN && errno != EINTR)
+            LOG_ERRNO(errno, "pty read");
+        return;
+    }
+
+    int err = opq_enqueue_write_cb(&opq_rt, buf, rc, _on_port_write_done);
+    if (err) {
+        LOG_WRN("pty %zd bytes dropped. queue full", rc);
+        free(buf);
+        return;
+    }
+
+    /* stop reading pty until written to serial port. this also applies
+     * backpressure on the tool writing to the pty */
+    pb->write_pending = true;
+    err = uv_poll_stop(&pb->poll_handle);
+    assert_uv_ok(err, "uv_poll_stop");
+}
+
+static void _uvcb_poll_event(uv_poll_t *handle, int status, int events)
+{
+    if (status) {
+        LOG_UV_ERR(status, "pty poll");
+        return;
+    }
+
+    if (events & UV_READABLE)
+        _on_master_readable();
+}
+
+static void _poll_start(void)
+{
+    struct pty_bridge_s *pb = &pty_bridge_data;
+
+    int err = uv_poll_start(&pb->poll_handle, UV_READABLE, _uvcb_poll_event);
+    assert_uv_ok(err, "uv_poll_start");
+}
+
+void pty_bridge_write(const void *data, size_t size)
+{
+    struct pty_bridge_s *pb = &pty_bridge_data;
+
+    if (!pb->initialized)
+        return;
+
+    /* non-blocking write directly from callers buffer. if no one reads the
+     * pty the buffer will eventually fill up - drop data in that case same as
+     * a serial line would */
+    ssize_t rc = write(pb->master_fd, data, size);
+    if (rc == size)
+        return;
+
+    if (rc < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            LOG_ERRNO(errno, "pty write");
+            return;
+        }
+        rc = 0;
+    }
+
+    if (!pb->dropped)
+        LOG_DBG("pty full. dropping data");
+
+    pb->dropped += size - rc;
+}
+
+void pty_bridge_init(void)
+{
+    struct pty_bridge_s *pb = &pty_bridge_data;
+    int err;
+
+    if (!pty_bridge_opts.enable)
+        return;
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+        SPCOM_EXIT(EX_OSERR, "posix_openpt - %s", strerror(errno));
+
+    if (grantpt(fd) || unlockpt(fd))
+        SPCOM_EXIT(EX_OSERR, "grantpt/unlockpt - %s", strerror(errno));
+
+    const char *name = ptsname(fd);
+    if (!name)
+        SPCOM_EXIT(EX_OSERR, "ptsname - %s", strerror(errno));
+
+    pb->master_fd = fd;
+
+    pb->slave_fd = open(name, O_RDWR | O_NOCTTY);
+    if (pb->slave_fd < 0)
+        SPCOM_EXIT(EX_OSERR, "open %s - %s", name, strerror(errno));
+
+    // no echo, no eol translation etc. tool can change this
+    struct termios t;
+    err = tcgetattr(pb->slave_fd, &t);
+    if (!err) {
+        cfmakeraw(&t);
+        err = tcsetattr(pb->slave_fd, TCSANOW, &t);
+    }
+    if (err)
+        LOG_ERRNO(errno, "pty termios");
+
+    err = uv_poll_init(uv_default_loop(), &pb->poll_handle, pb->master_fd);
+    assert_uv_ok(err, "uv_poll_init");
+
+    if (pty_bridge_opts.termios) {
+        err = uv_timer_init(uv_default_loop(), &pb->termios_timer);
+        assert_uv_ok(err, "uv_timer_init");
+
+        // first callback stores initial termios
+        err = uv_timer_start(&pb->termios_timer, _on_termios_timer, 0,
+                             PTY_BRIDGE_TERMIOS_POLL_MS);
+        assert_uv_ok(err, "uv_timer_start");
+    }
+
+    pb->initialized = true;
+    _poll_start();
+
+    LOG_INF("pty %s", name);
+}
+
+void pty_bridge_cleanup(void)
+{
+    struct pty_bridge_s *pb = &pty_bridge_data;
+
+    if (!pb->initialized)
+        return;
+
+    pb->initialized = false;
+
+    if (pb->dropped)
+        LOG_DBG("pty %zu bytes dropped", pb->dropped);
+
+    int err = uv_poll_stop(&pb->poll_handle);
+    (void)err;
+
+    if (pty_bridge_opts.termios) {
+        err = uv_timer_stop(&pb->termios_timer);
+        (void)err;
+    }
+
+    close(pb->slave_fd);
+    pb->slave_fd = -1;
+    /* note master fd closed here while uv handle might not be closed yet.
+     * ok as at exit */
+    close(pb->master_fd);
+    pb->master_fd = -1;
+}
+
+static int pty_bridge_opts_post_parse(const struct opt_section_entry *entry)
+{
+    // note: do not use LOG here
+    if (pty_bridge_opts.termios) {
+        pty_bridge_opts.enable = true;
+    }
+
+    return 0;
+}
+
+static const struct opt_conf pty_bridge_opts_conf[] = {
+    {
+        .name = "pty",
+        .dest = &pty_bridge_opts.enable,
+        .parse = opt_parse_flag_true,
+        .descr = "create a pseudo-terminal bridged to the serial port. "
+                 "Other tools can use the pty while spcom keeps monitoring. "
+                 "The pty path is printed on startup",
+    },
+    {
+        .name = "pty-termios",
+        .dest = &pty_bridge_opts.termios,
+        .parse = opt_parse_flag_true,
+        .descr = "apply baudrate, parity etc. set on the pty to the serial "
+                 "port. Implies --pty",
+    },
+};
+
+OPT_SECTION_ADD(pty_bridge,
+                pty_bridge_opts_conf,
+                ARRAY_LEN(pty_bridge_opts_conf),
+                pty_bridge_opts_post_parse);
@@ -0,0 +1,299 @@
+/**
+ * opt-in realtime mode for port I/O, i.e. the event loop or the port thread
+ * with `--io-thread`. That thread is set to SCHED_FIFO (or SCHED_RR) and
+ * optionally pinned to a CPU, memory is locked and the stack prefaulted so
+ * page faults do not delay reads.
+ *
+ * Each step may fail without privileges (CAP_SYS_NICE, CAP_IPC_LOCK or
+ * rlimits RTPRIO and MEMLOCK). Failures are warnings, not fatal, and what was
+ * actually granted is read back and logged. The port thread only records
+ * results, they are logged from the event loop, see realtime_log().
+ *
+ * Only the port I/O thread is realtime. Other threads, i.e. the log writer
+ * and modem monitor, are created with realtime_thread_attr_init() whether
+ * before or after realtime_init(). They get the default policy and the
+ * affinity of the process before `--rt-cpu`, i.e. nothing inherited from the
+ * creating thread, and a small stack. With mlockall() a thread stack is
+ * locked as a whole, and the default of 8 MiB per thread could exceed
+ * RLIMIT_MEMLOCK on reconnect.
+ */
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+// local
+#include "common.h"
+#include "log.h"
+#include "opt.h"
+#include "port_thread.h"
+#include "realtime.h"
+
+/// stack prefaulted, only the top is used. fits REALTIME_THREAD_STACK_SIZE
+#define REALTIME_STACK_PREFAULT (64 * 1024)
+/// stack of threads other than main, see realtime_thread_attr_init()
+#define REALTIME_THREAD_STACK_SIZE (256 * 1024)
+
+static struct realtime_opts_s {
+    int prio;
+    int policy;
+    int cpu;
+} realtime_opts = {
+    .policy = SCHED_FIFO,
+    .cpu = -1,
+};
+
+static struct realtime_s {
+    /// affinity of process before --rt-cpu, for other threads
+    bool have_cpus;
+    cpu_set_t cpus;
+} realtime_data;
+
+__attribute__((noinline))
+static void _stack_prefault(void)
+{
+    volatile unsigned char buf[REALTIME_STACK_PREFAULT];
+
+    for (size_t i = 0; i < sizeof(buf); i += 4096)
+        buf[i] = 0;
+}
+
+static void _lock_memory(void)
+{
+    // keep freed memory, i.e. no new faults when allocated again
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        struct rlimit rl;
+        getrlimit(RLIMIT_MEMLOCK, &rl);
+        LOG_WRN("mlockall failed '%s'. RLIMIT_MEMLOCK %llu KiB",
+                strerror(errno), (unsigned long long)rl.rlim_cur / 1024);
+    }
+}
+
+static void _set_affinity(struct realtime_status *st)
+{
+    cpu_set_t set;
+
+    if (realtime_opts.cpu < 0)
+        return;
+
+    CPU_ZERO(&set);
+    CPU_SET(realtime_opts.cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set))
+        st->affinity_err = errno;
+}
+
+static void _set_scheduler(struct realtime_status *st)
+{
+    const struct sched_param param = {
+        .sched_priority = realtime_opts.prio,
+    };
+
+    if (sched_setscheduler(0, realtime_opts.policy, &param))
+        st->sched_err = errno;
+}
+
+static const char *_policy_str(int policy)
+{
+    switch (policy) {
+        case SCHED_FIFO:
+            return "SCHED_FIFO";
+        case SCHED_RR:
+            return "SCHED_RR";
+        case SCHED_OTHER:
+            return "SCHED_OTHER";
+        default:
+            return "<unknown>";
+    }
+}
+
+/// locked memory from /proc, i.e. what mlockall() actually did
+static long _vm_locked_kib(void)
+{
+    FILE *fp = fopen("/proc/self/status", "r");
+    char line[128];
+    long kib = -1;
+
+    if (!fp)
+        return -1;
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "VmLck: %ld kB", &kib) == 1)
+            break;
+    }
+    fclose(fp);
+
+    return kib;
+}
+
+/// read back what was granted, regardless of what was asked for
+static void _read_back(struct realtime_status *st)
+{
+    struct sched_param param = { 0 };
+    cpu_set_t set;
+
+    st->policy = sched_getscheduler(0);
+    sched_getparam(0, &param);
+    st->prio = param.sched_priority;
+
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    st->cpus = CPU_COUNT(&set);
+    st->cpu = -1;
+    for (int i = 0; st->cpus == 1 && i < CPU_SETSIZE; i++) {
+        if (CPU_ISSET(i, &set))
+            st->cpu = i;
+    }
+}
+
+void realtime_log(const struct realtime_status *st)
+{
+    struct rlimit rl;
+    char cpus[32];
+
+    if (st->affinity_err)
+        LOG_WRN("sched_setaffinity cpu %d failed '%s'", realtime_opts.cpu,
+                strerror(st->affinity_err));
+
+    if (st->sched_err) {
+        getrlimit(RLIMIT_RTPRIO, &rl);
+        LOG_WRN("sched_setscheduler prio %d failed '%s'. RLIMIT_RTPRIO %llu",
+                realtime_opts.prio, strerror(st->sched_err),
+                (unsigned long long)rl.rlim_cur);
+    }
+
+    if (st->cpu >= 0)
+        snprintf(cpus, sizeof(cpus), "cpu %d", st->cpu);
+    else
+        snprintf(cpus, sizeof(cpus), "%d cpus", st->cpus);
+
+    LOG_INF("realtime: %s prio %d, %s, %ld KiB locked",
+            _policy_str(st->policy), st->prio, cpus, _vm_locked_kib());
+}
+
+bool realtime_thread_init(struct realtime_status *st)
+{
+    *st = (struct realtime_status){ 0 };
+
+    if (!realtime_opts.prio)
+        return false;
+
+    _stack_prefault();
+    _set_affinity(st);
+    _set_scheduler(st);
+    _read_back(st);
+
+    return true;
+}
+
+void realtime_thread_attr_init(pthread_attr_t *attr)
+{
+    struct realtime_s *rd = &realtime_data;
+    const struct sched_param param = { 0 };
+
+    pthread_attr_init(attr);
+    pthread_attr_setstacksize(attr, REALTIME_THREAD_STACK_SIZE);
+
+    // not inherited, e.g. from event loop with --realtime
+    pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(attr, SCHED_OTHER);
+    pthread_attr_setschedparam(attr, &param);
+
+    if (rd->have_cpus)
+        pthread_attr_setaffinity_np(attr, sizeof(rd->cpus), &rd->cpus);
+}
+
+void realtime_init(void)
+{
+    struct realtime_s *rd = &realtime_data;
+
+    if (!realtime_opts.prio)
+        return;
+
+    // before pinned, see realtime_thread_attr_init()
+    rd->have_cpus = !sched_getaffinity(0, sizeof(rd->cpus), &rd->cpus);
+
+    _lock_memory();
+
+    // else only the port thread, see port_thread.c
+    if (!port_thread_is_enabled()) {
+        struct realtime_status st;
+
+        realtime_thread_init(&st);
+        realtime_log(&st);
+    }
+}
+
+static int _parse_cb_prio(const struct opt_conf *conf, char *sval)
+{
+    int err = opt_parse_int(conf, sval);
+    if (err)
+        return err;
+
+    int max = sched_get_priority_max(SCHED_FIFO);
+    if (realtime_opts.prio < 1 || realtime_opts.prio > max)
+        return opt_perror(conf, "priority not in range [1, %d]", max);
+
+    return 0;
+}
+
+static int _parse_cb_policy(const struct opt_conf *conf, char *sval)
+{
+    if (!strcmp(sval, "fifo"))
+        realtime_opts.policy = SCHED_FIFO;
+    else if (!strcmp(sval, "rr"))
+        realtime_opts.policy = SCHED_RR;
+    else
+        return opt_perror(conf, "unknown policy '%s'", sval);
+
+    return 0;
+}
+
+static int _parse_cb_cpu(const struct opt_conf *conf, char *sval)
+{
+    int err = opt_parse_int(conf, sval);
+    if (err)
+        return err;
+
+    if (realtime_opts.cpu < 0 || realtime_opts.cpu >= CPU_SETSIZE)
+        return opt_perror(conf, "invalid cpu %d", realtime_opts.cpu);
+
+    return 0;
+}
+
+static const struct opt_conf realtime_opts_conf[] = {
+    {
+        .name = "realtime",
+        .dest = &realtime_opts.prio,
+        .parse = _parse_cb_prio,
+        .metavar = "PRIO",
+        .descr = "run port I/O with realtime priority PRIO (1-99) and lock "
+                 "memory, e.g. to avoid UART overruns on a loaded host. "
+                 "Requires CAP_SYS_NICE and CAP_IPC_LOCK or rlimits",
+    },
+    {
+        .name = "rt-policy",
+        .parse = _parse_cb_policy,
+        .metavar = "POLICY",
+        .descr = "scheduling policy with --realtime. fifo (default) or rr",
+    },
+    {
+        .name = "rt-cpu",
+        .dest = &realtime_opts.cpu,
+        .parse = _parse_cb_cpu,
+        .metavar = "CPU",
+        .descr = "pin port I/O to CPU with --realtime",
+    },
+};
+
+OPT_SECTION_ADD(realtime,
+                realtime_opts_conf,
+                ARRAY_LEN(realtime_opts_conf),
+                NULL);
@@ -0,0 +1,357 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+// local
+#include "rematch.h"
+
+#define BIT(N) ((uint64_t)1 << (N))
+
+/// set of bytes
+struct byteset {
+    uint8_t b[256 / 8];
+};
+
+static inline void _set_add(struct byteset *set, unsigned int c)
+{
+    set->b[c >> 3] |= 1 << (c & 7);
+}
+
+static inline bool _set_has(const struct byteset *set, unsigned int c)
+{
+    return set->b[c >> 3] & (1 << (c & 7));
+}
+
+static void _set_add_range(struct byteset *set, unsigned int lo,
+                           unsigned int hi)
+{
+    for (unsigned int c = lo; c <= hi; c++)
+        _set_add(set, c);
+}
+
+static void _set_invert(struct byteset *set)
+{
+    for (int i = 0; i < sizeof(set->b); i++)
+        set->b[i] = ~set->b[i];
+}
+
+static int _hexval(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20; // lower case
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/// `\d`, `\w`, `\s` and negated uppercase variants. false if not a shorthand
+static bool _parse_shorthand(int c, struct byteset *set)
+{
+    struct byteset tmp = { 0 };
+
+    for (unsigned int i = 0; i < 256; i++) {
+        bool in;
+        switch (tolower(c)) {
+            case 'd':
+                in = isdigit(i);
+                break;
+            case 'w':
+                in = isalnum(i) || i == '_';
+                break;
+            case 's':
+                in = isspace(i);
+                break;
+            default:
+                return false;
+        }
+        if (in)
+            _set_add(&tmp, i);
+    }
+
+    if (isupper(c))
+        _set_invert(&tmp);
+
+    for (int i = 0; i < sizeof(set->b); i++)
+        set->b[i] |= tmp.b[i];
+
+    return true;
+}
+
+/**
+ * parse escape sequence after backslash.
+ * @return byte value, or -1 if added to set as shorthand class, or -EINVAL
+ */
+static int _parse_escape(const char **ps, struct byteset *set)
+{
+    const char *s = *ps;
+    int c = (unsigned char)*s++;
+    int hi, lo;
+
+    switch (c) {
+        case '\0':
+            return -EINVAL;
+        case 'n':
+            c = '\n';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 't':
+            c = '\t';
+            break;
+        case 'e':
+            c = 0x1b;
+            break;
+        case '0':
+            c = '\0';
+            break;
+        case 'x':
+            hi = _hexval(s[0]);
+            lo = (hi < 0) ? -1 : _hexval(s[1]);
+            if (lo < 0)
+                return -EINVAL;
+            c = (hi << 4) | lo;
+            s += 2;
+            break;
+        default:
+            if (_parse_shorthand(c, set)) {
+                *ps = s;
+                return -1;
+            }
+            if (isalnum(c))
+                return -EINVAL; // reserved
+            break;
+    }
+
+    *ps = s;
+    return c;
+}
+
+static int _parse_class(const char **ps, struct byteset *set)
+{
+    const char *s = *ps;
+    bool negate = false;
+    struct byteset tmp = { 0 };
+
+    if (*s == '^') {
+        negate = true;
+        s++;
+    }
+
+    // `]` first in class is literal
+    bool first = true;
+    while (*s != ']' || first) {
+        first = false;
+        int c = (unsigned char)*s++;
+
+        if (c == '\0')
+            return -EINVAL;
+
+        if (c == '\\') {
+            c = _parse_escape(&s, &tmp);
+            if (c == -1)
+                continue; // shorthand
+            if (c < 0)
+                return c;
+        }
+
+        if (s[0] == '-' && s[1] != ']' && s[1] != '\0') {
+            s++;
+            int hi = (unsigned char)*s++;
+            if (hi == '\\') {
+                hi = _parse_escape(&s, &tmp);
+                if (hi < 0)
+                    return -EINVAL;
+            }
+            if (hi < c)
+                return -EINVAL;
+            _set_add_range(&tmp, c, hi);
+            continue;
+        }
+
+        _set_add(&tmp, c);
+    }
+
+    if (negate)
+        _set_invert(&tmp);
+
+    *set = tmp;
+    *ps = s + 1; // skip `]`
+    return 0;
+}
+
+static int _parse_atom(const char **ps, bool literal, struct byteset *set)
+{
+    const char *s = *ps;
+    int c = (unsigned char)*s++;
+
+    memset(set, 0, sizeof(*set));
+
+    if (literal) {
+        _set_add(set, c);
+        *ps = s;
+        return 0;
+    }
+
+    switch (c) {
+        case '.':
+            _set_add_range(set, 0, 255);
+            break;
+        case '[':
+            *ps = s;
+            return _parse_class(ps, set);
+        case '\\':
+            c = _parse_escape(&s, set);
+            if (c < -1)
+                return c;
+            if (c >= 0)
+                _set_add(set, c);
+            break;
+        case '?':
+        case '*':
+        case '+':
+            return -EINVAL; // nothing to repeat
+        default:
+            _set_add(set, c);
+            break;
+    }
+
+    *ps = s;
+    return 0;
+}
+
+/**
+ * epsilon closure - positions reachable by skipping optional positions.
+ * For each block of optional positions, every bit from the lowest active bit
+ * (including the entry bit before the block) up to the end of the block is
+ * set. Done for all blocks in parallel with a subtraction: the borrow from
+ * the entry bit runs through inactive bits until it hits a active one, or the
+ * guard bit at the end of block.
+ */
+static inline uint64_t _closure(const struct rematch *re, uint64_t d)
+{
+    if (!re->opt)
+        return d;
+
+    uint64_t x = (d & (re->opt | re->opt_entry)) | re->opt_last;
+    // inactive bits from entry up to first active bit
+    uint64_t below = ((x - re->opt_entry) ^ x) & ~x;
+    // borrow reached the guard - only the guard bit itself active
+    uint64_t guard_only = (below & (re->opt_last >> 1)) << 1;
+
+    return d | (re->opt & ~below & ~guard_only);
+}
+
+int rematch_compile(struct rematch *re, const char *pattern, bool literal)
+{
+    const char *s = pattern;
+    int pos = 0;
+
+    memset(re, 0, sizeof(*re));
+
+    while (*s) {
+        struct byteset set;
+        int err = _parse_atom(&s, literal, &set);
+        if (err)
+            return err;
+
+        if (++pos > REMATCH_POS_MAX)
+            return -E2BIG;
+
+        for (unsigned int c = 0; c < 256; c++) {
+            if (_set_has(&set, c))
+                re->table[c] |= BIT(pos);
+        }
+
+        if (literal)
+            continue;
+
+        switch (*s) {
+            case '?':
+                re->opt |= BIT(pos);
+                s++;
+                break;
+            case '*':
+                re->opt |= BIT(pos);
+                re->rep |= BIT(pos);
+                s++;
+                break;
+            case '+':
+                re->rep |= BIT(pos);
+                s++;
+                break;
+        }
+    }
+
+    if (!pos)
+        return -EINVAL;
+
+    for (int j = 1; j <= pos; j++) {
+        if (!(re->opt & BIT(j)))
+            continue;
+        if (!(re->opt & BIT(j - 1)))
+            re->opt_entry |= BIT(j - 1);
+        if (j == pos || !(re->opt & BIT(j + 1)))
+            re->opt_last |= BIT(j);
+    }
+
+    re->accept = BIT(pos);
+
+    rematch_reset(re);
+
+    // would match anything, e.g. "a*"
+    if (re->state & re->accept)
+        return -EINVAL;
+
+    return 0;
+}
+
+void rematch_reset(struct rematch *re)
+{
+    re->state = _closure(re, 1);
+}
+
+size_t rematch_feed(struct rematch *re, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    uint64_t d = re->state;
+
+    for (size_t i = 0; i < size; i++) {
+        uint64_t t = re->table[p[i]];
+        // advance, stay on repeatable positions and always (re)start
+        d = ((d << 1) & t) | (d & re->rep & t) | 1;
+        d = _closure(re, d);
+
+        if (d & re->accept) {
+            rematch_reset(re);
+            return i + 1;
+        }
+    }
+
+    re->state = d;
+    return 0;
+}
+
+size_t rematch_match_at(const struct rematch *re, const void *data,
+                        size_t size)
+{
+    const unsigned char *p = data;
+    uint64_t d = _closure(re, 1);
+    size_t len = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        uint64_t t = re->table[p[i]];
+        // as rematch_feed but no restart
+        d = ((d << 1) & t) | (d & re->rep & t);
+        if (!d)
+            break;
+
+        d = _closure(re, d);
+        if (d & re->accept)
+            len = i + 1;
+    }
+
+    return len;
+}
@@ -0,0 +1,886 @@
+/**
+ * RFC 2217 - Telnet Com Port Control Option. Server side only.
+ *
+ * Data from client is written to the serial port through opq_rt (same as
+ * shell input) and data received from serial port is forwarded to client.
+ * Port settings requested by client are converted to `OP_PORT_{BAUD, ...}`
+ * operations, i.e. applied in order with any data written before them.
+ *
+ * IAC (0xFF) escaping is done with memchr() on the data path - no per byte
+ * branching on binary data unless 0xFF is present.
+ *
+ * Port data is dropped, and logged, while more than RFC2217_PENDING_MAX is
+ * queued for a client that does not keep up.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+// deps
+#include <libserialport.h>
+#include <uv.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "log.h"
+#include "opq.h"
+#include "opt.h"
+#include "port_opts.h"
+#include "strto.h"
+#include "rfc2217.h"
+
+#define RFC2217_DEFAULT_HOST "127.0.0.1"
+#define RFC2217_RDBUF_SIZE 4096
+#define RFC2217_TXBUF_SIZE 1024
+#define RFC2217_SB_MAX 16
+/// port data queued for a slow client. dropped above, same as sniff
+#define RFC2217_PENDING_MAX (64 * 1024)
+
+// telnet commands (RFC 854)
+#define T_SE   240
+#define T_SB   250
+#define T_WILL 251
+#define T_WONT 252
+#define T_DO   253
+#define T_DONT 254
+#define T_IAC  255
+
+// telnet options
+#define T_OPT_BINARY   0
+#define T_OPT_SGA      3
+#define T_OPT_COM_PORT 44
+
+/// client to server commands. server reply with same value + 100
+enum cpo_cmd_e {
+    CPO_SIGNATURE = 0,
+    CPO_SET_BAUDRATE = 1,
+    CPO_SET_DATASIZE = 2,
+    CPO_SET_PARITY = 3,
+    CPO_SET_STOPSIZE = 4,
+    CPO_SET_CONTROL = 5,
+    CPO_NOTIFY_LINESTATE = 6,
+    CPO_NOTIFY_MODEMSTATE = 7,
+    CPO_FLOWCONTROL_SUSPEND = 8,
+    CPO_FLOWCONTROL_RESUME = 9,
+    CPO_SET_LINESTATE_MASK = 10,
+    CPO_SET_MODEMSTATE_MASK = 11,
+    CPO_PURGE_DATA = 12,
+    CPO_SERVER_OFFSET = 100,
+};
+
+/// SET-CONTROL values that are requests for current state
+enum cpo_control_query_e {
+    CPO_CTRL_Q_OUTFLOW = 0,
+    CPO_CTRL_Q_BREAK = 4,
+    CPO_CTRL_Q_DTR = 7,
+    CPO_CTRL_Q_RTS = 10,
+    CPO_CTRL_Q_INFLOW = 13,
+    CPO_CTRL_MAX = 19,
+};
+
+enum tn_state_e {
+    TN_DATA = 0,
+    TN_IAC,
+    TN_OPT,
+    TN_SB,
+    TN_SB_IAC,
+};
+
+static struct rfc2217_opts_s {
+    const char *host;
+    int port;
+} rfc2217_opts = {
+    .host = RFC2217_DEFAULT_HOST,
+};
+
+static struct rfc2217_s {
+    bool initialized;
+    uv_tcp_t server;
+    uv_tcp_t client;
+    /// client handle in use (might be closing)
+    bool have_client;
+    bool connected;
+    /// client data enqueued but not yet written to serial port
+    unsigned int pending_writes;
+    bool suspended;
+    size_t dropped;
+    /// port data dropped as client write queue full
+    size_t overflow;
+    // telnet parser
+    enum tn_state_e state;
+    unsigned char verb;
+    unsigned char sb[RFC2217_SB_MAX];
+    size_t sb_len;
+    /// enabled options bitmask. see _optbit()
+    uint8_t us;
+    uint8_t them;
+    /// last value per SET-CONTROL group. index is the query value
+    uint8_t control[CPO_CTRL_MAX + 1];
+    // mirror of values set. used for replies. negative if unknown
+    int baudrate;
+    int databits;
+    int parity;
+    int stopbits;
+    unsigned char txbuf[2 * RFC2217_TXBUF_SIZE];
+} rfc2217_data;
+
+/// SET-CONTROL value to operation
+static const struct {
+    uint16_t op_code;
+    int val;
+} cpo_control_map[CPO_CTRL_MAX + 1] = {
+    // clang-format off
+    [ 1] = { OP_PORT_FLOW,    SP_FLOWCONTROL_NONE },
+    [ 2] = { OP_PORT_FLOW,    SP_FLOWCONTROL_XONXOFF },
+    [ 3] = { OP_PORT_FLOW,    SP_FLOWCONTROL_RTSCTS },
+    [ 5] = { OP_PORT_BREAK,   1 },
+    [ 6] = { OP_PORT_BREAK,   0 },
+    [ 8] = { OP_PORT_SET_DTR, 1 },
+    [ 9] = { OP_PORT_SET_DTR, 0 },
+    [11] = { OP_PORT_SET_RTS, 1 },
+    [12] = { OP_PORT_SET_RTS, 0 },
+    [14] = { OP_PORT_FLOW,    SP_FLOWCONTROL_NONE },
+    [15] = { OP_PORT_FLOW,    SP_FLOWCONTROL_XONXOFF },
+    [16] = { OP_PORT_FLOW,    SP_FLOWCONTROL_RTSCTS },
+    [18] = { OP_PORT_FLOW,    SP_FLOWCONTROL_DTRDSR },
+    [19] = { OP_PORT_FLOW,    SP_FLOWCONTROL_DTRDSR },
+    // clang-format on
+};
+
+/// index is RFC 2217 parity value
+static const int cpo_parity_map[] = {
+    [0] = -1,
+    [1] = SP_PARITY_NONE,
+    [2] = SP_PARITY_ODD,
+    [3] = SP_PARITY_EVEN,
+    [4] = SP_PARITY_MARK,
+    [5] = SP_PARITY_SPACE,
+};
+
+static void _read_start(void);
+
+static uint8_t _optbit(unsigned char opt)
+{
+    switch (opt) {
+        case T_OPT_BINARY:
+            return (1 << 0);
+        case T_OPT_SGA:
+            return (1 << 1);
+        case T_OPT_COM_PORT:
+            return (1 << 2);
+        default:
+            return 0;
+    }
+}
+
+static void _on_client_write_done(uv_write_t *req, int status)
+{
+    if (status)
+        LOG_UV_DBG(status, "rfc2217 uv_write");
+    // data allocated together with req
+    free(req);
+}
+
+/**
+ * write directly from callers buffer if possible. only data not written
+ * immediately is copied.
+ */
+static void _client_send(const void *data, size_t size)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    if (!r->connected || !size)
+        return;
+
+    uv_stream_t *stream = (uv_stream_t *)&r->client;
+    const char *src = data;
+    uv_buf_t buf = uv_buf_init((char *)src, size);
+
+    // returns UV_EAGAIN if other writes pending - keeps order
+    int rc = uv_try_write(stream, &buf, 1);
+    if (rc == size)
+        return;
+
+    if (rc > 0) {
+        src += rc;
+        size -= rc;
+    }
+    else if (rc != UV_EAGAIN) {
+        // connection error handled in read callback
+        LOG_UV_DBG(rc, "rfc2217 uv_try_write");
+        return;
+    }
+
+    uv_write_t *req = malloc(sizeof(*req) + size);
+    assert(req);
+    char *p = (char *)(req + 1);
+    memcpy(p, src, size);
+    buf = uv_buf_init(p, size);
+
+    int err = uv_write(req, stream, &buf, 1, _on_client_write_done);
+    if (err) {
+        LOG_UV_ERR(err, "rfc2217 uv_write");
+        free(req);
+    }
+}
+
+/// double every IAC. dst must be at least twice the size of src
+static size_t _iac_escape(unsigned char *dst, const unsigned char *src,
+                          size_t size)
+{
+    unsigned char *d = dst;
+    const unsigned char *end = src + size;
+
+    while (src < end) {
+        const unsigned char *iac = memchr(src, T_IAC, end - src);
+        // including the IAC
+        size_t n = (iac ? iac + 1 : end) - src;
+
+        memcpy(d, src, n);
+        d += n;
+        src += n;
+
+        if (iac)
+            *d++ = T_IAC;
+    }
+
+    return d - dst;
+}
+
+void rfc2217_write(const void *data, size_t size)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    if (!r->connected)
+        return;
+
+    if (r->suspended) {
+        r->dropped += size;
+        return;
+    }
+
+    // whole chunks only, i.e. telnet replies never dropped
+    uv_stream_t *stream = (uv_stream_t *)&r->client;
+    if (uv_stream_get_write_queue_size(stream) + size > RFC2217_PENDING_MAX) {
+        r->overflow += size;
+        return;
+    }
+
+    if (r->overflow) {
+        LOG_WRN("rfc2217 %zu bytes dropped. client too slow", r->overflow);
+        r->overflow = 0;
+    }
+
+    const unsigned char *src = data;
+
+    // common case - no escape needed, no copy
+    if (!memchr(src, T_IAC, size)) {
+        _client_send(src, size);
+        return;
+    }
+
+    while (size) {
+        size_t n = (size < RFC2217_TXBUF_SIZE) ? size : RFC2217_TXBUF_SIZE;
+        size_t len = _iac_escape(r->txbuf, src, n);
+        _client_send(r->txbuf, len);
+        src += n;
+        size -= n;
+    }
+}
+
+static void _send_opt(unsigned char verb, unsigned char opt)
+{
+    const unsigned char buf[] = { T_IAC, verb, opt };
+    _client_send(buf, sizeof(buf));
+}
+
+/// reply to com port option subnegotiation.
+static void _send_reply(unsigned char cmd, const void *val, size_t size)
+{
+    unsigned char buf[4 + 2 * RFC2217_SB_MAX + 2];
+    unsigned char *p = buf;
+
+    assert(size <= RFC2217_SB_MAX);
+
+    *p++ = T_IAC;
+    *p++ = T_SB;
+    *p++ = T_OPT_COM_PORT;
+    *p++ = cmd + CPO_SERVER_OFFSET;
+    p += _iac_escape(p, val, size);
+    *p++ = T_IAC;
+    *p++ = T_SE;
+
+    _client_send(buf, p - buf);
+}
+
+static void _send_reply_u8(unsigned char cmd, int val)
+{
+    const unsigned char b = (val >= 0) ? val : 0;
+    _send_reply(cmd, &b, 1);
+}
+
+static void _send_reply_u32(unsigned char cmd, int val)
+{
+    const uint32_t v = (val >= 0) ? val : 0;
+    const unsigned char b[4] = { v >> 24, v >> 16, v >> 8, v };
+    _send_reply(cmd, b, sizeof(b));
+}
+
+/// only respond if state changed to avoid negotiation loops (RFC 854)
+static void _negotiate(unsigned char verb, unsigned char opt)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+    uint8_t bit = _optbit(opt);
+
+    switch (verb) {
+        case T_WILL:
+            if (!bit) {
+                _send_opt(T_DONT, opt);
+            }
+            else if (!(r->them & bit)) {
+                r->them |= bit;
+                _send_opt(T_DO, opt);
+            }
+            break;
+
+        case T_WONT:
+            if (r->them & bit) {
+                r->them &= ~bit;
+                _send_opt(T_DONT, opt);
+            }
+            break;
+
+        case T_DO:
+            if (!bit) {
+                _send_opt(T_WONT, opt);
+            }
+            else if (!(r->us & bit)) {
+                r->us |= bit;
+                _send_opt(T_WILL, opt);
+            }
+            break;
+
+        case T_DONT:
+            if (r->us & bit) {
+                r->us &= ~bit;
+                _send_opt(T_WONT, opt);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static bool _enqueue_op(uint16_t op_code, int val)
+{
+    // never assert on a full queue because of a chatty client
+    if (!opq_acquire_tail(&opq_rt)) {
+        LOG_WRN("rfc2217 op %d dropped. queue full", op_code);
+        return false;
+    }
+
+    int err = opq_enqueue_val(&opq_rt, op_code, val);
+    return !err;
+}
+
+static void _on_port_write_done(const struct opq_item *itm)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    assert(itm->u.data);
+    free(itm->u.data);
+
+    assert(r->pending_writes > 0);
+    r->pending_writes--;
+
+    if (!r->pending_writes && r->connected)
+        _read_start();
+}
+
+/// @param data must be allocated with malloc. ownership passed on
+static void _enqueue_data(void *data, size_t size)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    int err = opq_enqueue_write_cb(&opq_rt, data, size, _on_port_write_done);
+    if (err) {
+        LOG_WRN("rfc2217 %zu bytes dropped. queue full", size);
+        free(data);
+        return;
+    }
+
+    /* stop reading until written to serial port. a tcp client can send
+     * data much faster than the serial port can output it */
+    if (!r->pending_writes) {
+        int err = uv_read_stop((uv_stream_t *)&r->client);
+        (void)err; // always succeeds according to doc
+    }
+
+    r->pending_writes++;
+}
+
+static int _control_query_of(int v)
+{
+    if (v < CPO_CTRL_Q_BREAK)
+        return CPO_CTRL_Q_OUTFLOW;
+    if (v < CPO_CTRL_Q_DTR)
+        return CPO_CTRL_Q_BREAK;
+    if (v < CPO_CTRL_Q_RTS)
+        return CPO_CTRL_Q_DTR;
+    if (v < CPO_CTRL_Q_INFLOW)
+        return CPO_CTRL_Q_RTS;
+
+    return CPO_CTRL_Q_INFLOW;
+}
+
+static void _on_set_control(int v)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    if (v > CPO_CTRL_MAX) {
+        LOG_DBG("rfc2217 set control %d not supported", v);
+        return;
+    }
+
+    int q = _control_query_of(v);
+
+    if (v != q && cpo_control_map[v].op_code) {
+        if (_enqueue_op(cpo_control_map[v].op_code, cpo_control_map[v].val))
+            r->control[q] = v;
+    }
+
+    _send_reply_u8(CPO_SET_CONTROL, r->control[q]);
+}
+
+static void _on_subneg(void)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    if (r->sb_len < 2 || r->sb[0] != T_OPT_COM_PORT)
+        return;
+
+    const unsigned char cmd = r->sb[1];
+    const unsigned char *val = &r->sb[2];
+    const size_t vlen = r->sb_len - 2;
+    int v = vlen ? val[0] : 0;
+
+    switch (cmd) {
+        case CPO_SIGNATURE:
+            _send_reply(cmd, "spcom", 5);
+            break;
+
+        case CPO_SET_BAUDRATE:
+            if (vlen < 4)
+                break;
+            v = ((uint32_t)val[0] << 24) | ((uint32_t)val[1] << 16)
+                | ((uint32_t)val[2] << 8) | val[3];
+            // zero is a request for current value
+            if (v > 0 && _enqueue_op(OP_PORT_BAUD, v))
+                r->baudrate = v;
+
+            _send_reply_u32(cmd, r->baudrate);
+            break;
+
+        case CPO_SET_DATASIZE:
+            if (v >= 5 && v <= 8 && _enqueue_op(OP_PORT_DATABITS, v))
+                r->databits = v;
+
+            _send_reply_u8(cmd, r->databits);
+            break;
+
+        case CPO_SET_PARITY:
+            if (v > 0 && v < ARRAY_LEN(cpo_parity_map)
+                && _enqueue_op(OP_PORT_PARITY, cpo_parity_map[v]))
+                r->parity = v;
+
+            _send_reply_u8(cmd, r->parity);
+            break;
+
+        case CPO_SET_STOPSIZE:
+            // 3 is 1.5 stopbits, not supported by libserialport
+            if (v >= 1 && v <= 2 && _enqueue_op(OP_PORT_STOPBITS, v))
+                r->stopbits = v;
+
+            _send_reply_u8(cmd, r->stopbits);
+            break;
+
+        case CPO_SET_CONTROL:
+            _on_set_control(v);
+            break;
+
+        case CPO_FLOWCONTROL_SUSPEND:
+            r->suspended = true;
+            break;
+
+        case CPO_FLOWCONTROL_RESUME:
+            r->suspended = false;
+            if (r->dropped) {
+                LOG_WRN("rfc2217 %zu bytes dropped while suspended",
+                        r->dropped);
+                r->dropped = 0;
+            }
+            break;
+
+        case CPO_SET_LINESTATE_MASK:
+        case CPO_SET_MODEMSTATE_MASK:
+            // no notifications sent but acknowledge
+            _send_reply_u8(cmd, v);
+            break;
+
+        case CPO_PURGE_DATA:
+            // 1 rx, 2 tx and 3 both. same values as SP_BUF_{INPUT, ...}
+            if (v >= SP_BUF_INPUT && v <= SP_BUF_BOTH)
+                _enqueue_op(OP_PORT_FLUSH, v);
+
+            _send_reply_u8(cmd, v);
+            break;
+
+        default:
+            LOG_DBG("rfc2217 command %u ignored", cmd);
+            break;
+    }
+}
+
+/**
+ * parse telnet stream in place. data bytes are compacted to the start of
+ * buf, which is enqueued as is unless a command was found mid-buffer.
+ * @param buf allocated with malloc. always consumed
+ */
+static void _parse(unsigned char *buf, size_t size)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    unsigned char *rdp = buf;
+    unsigned char *wrp = buf;
+    // start of data not yet enqueued
+    unsigned char *seg = buf;
+    const unsigned char *end = buf + size;
+
+    while (rdp < end) {
+
+        if (r->state == TN_DATA) {
+            unsigned char *iac = memchr(rdp, T_IAC, end - rdp);
+            size_t n = (iac ? iac : end) - rdp;
+            if (wrp != rdp)
+                memmove(wrp, rdp, n);
+
+            wrp += n;
+            rdp += n;
+
+            if (!iac)
+                break;
+
+            rdp++;
+            r->state = TN_IAC;
+            continue;
+        }
+
+        unsigned char c = *rdp++;
+
+        switch (r->state) {
+            case TN_IAC:
+                switch (c) {
+                    case T_IAC:
+                        // escaped 0xFF data byte
+                        *wrp++ = T_IAC;
+                        r->state = TN_DATA;
+                        break;
+                    case T_WILL:
+                    case T_WONT:
+                    case T_DO:
+                    case T_DONT:
+                        r->verb = c;
+                        r->state = TN_OPT;
+                        break;
+                    case T_SB:
+                        r->sb_len = 0;
+                        r->state = TN_SB;
+                        break;
+                    default:
+                        // NOP, GA, AYT etc. ignored
+                        r->state = TN_DATA;
+                        break;
+                }
+                break;
+
+            case TN_OPT:
+                _negotiate(r->verb, c);
+                r->state = TN_DATA;
+                break;
+
+            case TN_SB:
+                if (c == T_IAC)
+                    r->state = TN_SB_IAC;
+                else if (r->sb_len < sizeof(r->sb))
+                    r->sb[r->sb_len++] = c;
+                break;
+
+            case TN_SB_IAC:
+                if (c == T_IAC) {
+                    if (r->sb_len < sizeof(r->sb))
+                        r->sb[r->sb_len++] = c;
+                    r->state = TN_SB;
+                    break;
+                }
+
+                r->state = TN_DATA;
+                if (c != T_SE)
+                    break; // protocol error. ignore subnegotiation
+
+                // data received before command must be written before it
+                if (wrp > seg) {
+                    void *tmp = malloc(wrp - seg);
+                    assert(tmp);
+                    memcpy(tmp, seg, wrp - seg);
+                    _enqueue_data(tmp, wrp - seg);
+                    seg = wrp;
+                }
+
+                _on_subneg();
+                break;
+
+            default:
+                assert(0);
+                break;
+        }
+    }
+
+    size_t remains = wrp - seg;
+    if (!remains) {
+        free(buf);
+        return;
+    }
+
+    if (seg != buf)
+        memmove(buf, seg, remains);
+
+    _enqueue_data(buf, remains);
+}
+
+static void _uvcb_alloc(uv_handle_t *handle, size_t size, uv_buf_t *buf)
+{
+    // freed when written to serial port
+    buf->base = malloc(RFC2217_RDBUF_SIZE);
+    buf->len = buf->base ? RFC2217_RDBUF_SIZE : 0;
+}
+
+static void _on_client_close(uv_handle_t *handle)
+{
+    rfc2217_data.have_client = false;
+}
+
+static void _client_close(void)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    if (!r->connected)
+        return;
+
+    if (r->overflow)
+        LOG_WRN("rfc2217 %zu bytes dropped. client too slow", r->overflow);
+
+    r->connected = false;
+    uv_close((uv_handle_t *)&r->client, _on_client_close);
+}
+
+static void _uvcb_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
+{
+    if (nread < 0) {
+        free(buf->base);
+        if (nread == UV_EOF)
+            LOG_INF("rfc2217 client disconnected");
+        else
+            LOG_UV_ERR(nread, "rfc2217 read");
+
+        _client_close();
+        return;
+    }
+
+    if (nread == 0) {
+        // EAGAIN
+        free(buf->base);
+        return;
+    }
+
+    _parse((unsigned char *)buf->base, nread);
+}
+
+static void _read_start(void)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+    int err = uv_read_start((uv_stream_t *)&r->client, _uvcb_alloc,
+                            _uvcb_read);
+    if (err) {
+        LOG_UV_ERR(err, "rfc2217 uv_read_start");
+        _client_close();
+    }
+}
+
+static void _on_close_free(uv_handle_t *handle)
+{
+    free(handle);
+}
+
+static void _reject(uv_stream_t *server)
+{
+    uv_tcp_t *tmp = malloc(sizeof(*tmp));
+    assert(tmp);
+
+    int err = uv_tcp_init(uv_default_loop(), tmp);
+    assert_uv_ok(err, "uv_tcp_init");
+
+    err = uv_accept(server, (uv_stream_t *)tmp);
+    if (err)
+        LOG_UV_DBG(err, "uv_accept");
+
+    uv_close((uv_handle_t *)tmp, _on_close_free);
+}
+
+static void _on_connection(uv_stream_t *server, int status)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    if (status < 0) {
+        LOG_UV_ERR(status, "rfc2217 connection");
+        return;
+    }
+
+    if (r->have_client) {
+        LOG_WRN("rfc2217 client rejected. Only one client at a time");
+        _reject(server);
+        return;
+    }
+
+    int err = uv_tcp_init(uv_default_loop(), &r->client);
+    assert_uv_ok(err, "uv_tcp_init");
+    r->have_client = true;
+
+    err = uv_accept(server, (uv_stream_t *)&r->client);
+    if (err) {
+        LOG_UV_ERR(err, "rfc2217 uv_accept");
+        uv_close((uv_handle_t *)&r->client, _on_client_close);
+        return;
+    }
+
+    // low latency on small writes
+    err = uv_tcp_nodelay(&r->client, 1);
+    if (err)
+        LOG_UV_DBG(err, "uv_tcp_nodelay");
+
+    r->connected = true;
+    r->state = TN_DATA;
+    r->suspended = false;
+    r->dropped = 0;
+    r->overflow = 0;
+
+    // server side options enabled and the ones requested from client
+    r->us = _optbit(T_OPT_BINARY) | _optbit(T_OPT_SGA);
+    r->them = _optbit(T_OPT_BINARY) | _optbit(T_OPT_SGA)
+              | _optbit(T_OPT_COM_PORT);
+
+    _send_opt(T_WILL, T_OPT_BINARY);
+    _send_opt(T_WILL, T_OPT_SGA);
+    _send_opt(T_DO, T_OPT_BINARY);
+    _send_opt(T_DO, T_OPT_SGA);
+    _send_opt(T_DO, T_OPT_COM_PORT);
+
+    // otherwise started when previous clients data written
+    if (!r->pending_writes)
+        _read_start();
+
+    LOG_INF("rfc2217 client connected");
+}
+
+void rfc2217_init(void)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+    const struct rfc2217_opts_s *o = &rfc2217_opts;
+
+    if (!o->port)
+        return;
+
+    r->baudrate = port_opts->baudrate;
+    r->databits = port_opts->databits;
+    r->stopbits = port_opts->stopbits;
+    r->parity = -1;
+    for (int i = 1; i < ARRAY_LEN(cpo_parity_map); i++) {
+        if (cpo_parity_map[i] == port_opts->parity)
+            r->parity = i;
+    }
+
+    r->control[CPO_CTRL_Q_OUTFLOW] = 1;
+    r->control[CPO_CTRL_Q_BREAK] = 6;
+    r->control[CPO_CTRL_Q_DTR] = 8;
+    r->control[CPO_CTRL_Q_RTS] = 11;
+    r->control[CPO_CTRL_Q_INFLOW] = 14;
+
+    struct sockaddr_in addr;
+    int err = uv_ip4_addr(o->host, o->port, &addr);
+    if (err)
+        SPCOM_EXIT(EX_USAGE, "invalid rfc2217 address '%s'", o->host);
+
+    err = uv_tcp_init(uv_default_loop(), &r->server);
+    assert_uv_ok(err, "uv_tcp_init");
+
+    err = uv_tcp_bind(&r->server, (const struct sockaddr *)&addr, 0);
+    if (!err)
+        err = uv_listen((uv_stream_t *)&r->server, 1, _on_connection);
+
+    if (err) {
+        SPCOM_EXIT(EX_UNAVAILABLE, "rfc2217 listen on %s:%d failed, %s",
+                   o->host, o->port, uv_strerror(err));
+    }
+
+    r->initialized = true;
+    LOG_INF("rfc2217 server listening on %s:%d", o->host, o->port);
+}
+
+void rfc2217_cleanup(void)
+{
+    struct rfc2217_s *r = &rfc2217_data;
+
+    if (!r->initialized)
+        return;
+
+    _client_close();
+    uv_close((uv_handle_t *)&r->server, NULL);
+    r->initialized = false;
+}
+
+static int _parse_cb_listen(const struct opt_conf *conf, char *sval)
+{
+    char *sp = strrchr(sval, ':');
+    if (sp) {
+        *sp++ = '\0';
+        if (sval[0] != '\0')
+            rfc2217_opts.host = sval;
+    }
+    else {
+        sp = sval;
+    }
+
+    int port = 0;
+    int err = strto_i(sp, NULL, 10, &port);
+    if (err || port <= 0 || port > 0xffff)
+        return opt_perror(conf, "invalid tcp port '%s'", sp);
+
+    rfc2217_opts.port = port;
+    return 0;
+}
+
+static const struct opt_conf rfc2217_opts_conf[] = {
+    {
+        .name = "rfc2217",
+        .parse = _parse_cb_listen,
+        .metavar = "[HOST:]PORT",
+        .descr = "RFC 2217 (telnet com port control) server. Remote clients "
+                 "can use and configure the serial port while spcom keeps "
+                 "monitoring it. HOST default " RFC2217_DEFAULT_HOST,
+    },
+};
+
+OPT_SECTION_ADD(rfc2217,
+                rfc2217_opts_conf,
+                ARRAY_LEN(rfc2217_opts_conf),
+                NULL);
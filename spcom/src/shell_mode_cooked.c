@@ -10,6 +10,7 @@
 #include "opq.h"
 #include "opt.h"
 #include "shell.h"
+#include "trace.h"
 
 static struct {
     const char *prompt;
@@ -108,6 +109,7 @@ static void _rl_state_restore(bool was_saved)
     rl_restore_prompt();
     rl_replace_line(state->line, 0);
     rl_point = state->point;
+    TRACE(TRACE_SHELL_REDRAW, 0);
     rl_forced_update_display();
     free(state->line);
     state->line = NULL;
@@ -0,0 +1,388 @@
+/**
+ * sniffer (man-in-the-middle) mode. bytes received on port A (`--port`) are
+ * written to port B (`--sniff`) and vice versa, while recorded to capture file
+ * with direction tags.
+ *
+ * Forwarding is done from the read buffer with a direct non-blocking write.
+ * Data is only copied when the destination can not take all of it at once,
+ * and then held until destination is writable. The time from read to write
+ * is measured per byte and reported on exit.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+// deps
+#include <libserialport.h>
+#include <uv.h>
+// local
+#include "assert.h"
+#include "capture.h"
+#include "common.h"
+#include "log.h"
+#include "misc.h"
+#include "opq.h"
+#include "opt.h"
+#include "port.h"
+#include "port_opts.h"
+#include "sniff.h"
+
+#define SNIFF_RDBUF_SIZE 4096
+/// max bytes held back per direction before dropping
+#define SNIFF_PENDING_MAX (64 * 1024)
+
+/// data not yet written to destination port
+struct sniff_chunk {
+    struct sniff_chunk *next;
+    /// uv_hrtime() when read from source port
+    uint64_t ts;
+    size_t size;
+    size_t offset;
+    char data[];
+};
+
+struct sniff_stats {
+    size_t bytes;
+    size_t dropped;
+    /// sum of latency (ns) for each byte
+    double lat_sum;
+    uint64_t lat_max;
+};
+
+static struct sniff_opts_s {
+    const char *name;
+} sniff_opts;
+
+static struct sniff_s {
+    bool initialized;
+    struct sp_port *port;
+    struct sp_port_config *org_config;
+    uv_poll_t poll_handle;
+    /// held back A to B. written on B writable
+    struct sniff_chunk *head;
+    struct sniff_chunk *tail;
+    size_t b_pending;
+    /// held back B to A. chunks on opq, written by port.c
+    unsigned int a_queued;
+    size_t a_pending;
+    struct sniff_stats a2b;
+    struct sniff_stats b2a;
+} sniff_data;
+
+static void _stats_add(struct sniff_stats *st, uint64_t ts, size_t n)
+{
+    uint64_t lat = uv_hrtime() - ts;
+
+    st->bytes += n;
+    st->lat_sum += (double)lat * n;
+    if (lat > st->lat_max)
+        st->lat_max = lat;
+}
+
+static void _stats_log(const char *tag, const struct sniff_stats *st)
+{
+    double avg_us = st->bytes ? st->lat_sum / st->bytes / 1000.0 : 0.0;
+
+    LOG_INF("%s %zu bytes, latency avg %.1f us, max %.1f us, dropped %zu", tag,
+            st->bytes, avg_us, st->lat_max / 1000.0, st->dropped);
+}
+
+static struct sniff_chunk *_chunk_new(const void *data, size_t size,
+                                      uint64_t ts)
+{
+    struct sniff_chunk *c = malloc(sizeof(*c) + size);
+    assert(c);
+
+    c->next = NULL;
+    c->ts = ts;
+    c->size = size;
+    c->offset = 0;
+    memcpy(c->data, data, size);
+
+    return c;
+}
+
+static void _poll_start(int events);
+
+static void _on_b_writable(void)
+{
+    struct sniff_s *s = &sniff_data;
+
+    while (s->head) {
+        struct sniff_chunk *c = s->head;
+        size_t remains = c->size - c->offset;
+
+        int rc = sp_nonblocking_write(s->port, &c->data[c->offset], remains);
+        if (rc < 0)
+            SPCOM_EXIT(EX_IOERR, "sniff port write - %s",
+                       misc_sp_err_to_str(rc));
+
+        if (rc == 0)
+            return; // EAGAIN
+
+        _stats_add(&s->a2b, c->ts, rc);
+        s->b_pending -= rc;
+
+        if (rc < remains) {
+            c->offset += rc;
+            return;
+        }
+
+        s->head = c->next;
+        free(c);
+    }
+
+    s->tail = NULL;
+    _poll_start(UV_READABLE);
+}
+
+void sniff_write(const void *data, size_t size)
+{
+    struct sniff_s *s = &sniff_data;
+
+    if (!s->initialized || !size)
+        return;
+
+    uint64_t ts = uv_hrtime();
+
+    // anything already held back must go first
+    if (!s->head) {
+        int rc = sp_nonblocking_write(s->port, data, size);
+        if (rc < 0)
+            SPCOM_EXIT(EX_IOERR, "sniff port write - %s",
+                       misc_sp_err_to_str(rc));
+
+        _stats_add(&s->a2b, ts, rc);
+        if (rc == size)
+            return;
+
+        data = (const char *)data + rc;
+        size -= rc;
+    }
+
+    if (s->b_pending + size > SNIFF_PENDING_MAX) {
+        s->a2b.dropped += size;
+        return;
+    }
+
+    struct sniff_chunk *c = _chunk_new(data, size, ts);
+    if (s->tail)
+        s->tail->next = c;
+    else
+        s->head = c;
+    s->tail = c;
+    s->b_pending += size;
+
+    _poll_start(UV_READABLE | UV_WRITABLE);
+}
+
+static void _on_a_write_done(const struct opq_item *itm)
+{
+    struct sniff_s *s = &sniff_data;
+    struct sniff_chunk *c =
+        (struct sniff_chunk *)((char *)itm->u.data -
+                               offsetof(struct sniff_chunk, data));
+
+    // not done if opq released on port close, i.e. not written
+    if (itm->done)
+        _stats_add(&s->b2a, c->ts, c->size);
+    else
+        s->b2a.dropped += c->size;
+
+    s->a_queued--;
+    s->a_pending -= c->size;
+    free(c);
+}
+
+static void _forward_to_a(const char *data, size_t size, uint64_t ts)
+{
+    struct sniff_s *s = &sniff_data;
+
+    // anything already held back must go first
+    if (!s->a_queued) {
+        int rc = port_write(data, size);
+        if (rc < 0) {
+            // port A gone or not ready yet
+            s->b2a.dropped += size;
+            return;
+        }
+
+        _stats_add(&s->b2a, ts, rc);
+        if (rc == size)
+            return;
+
+        data += rc;
+        size -= rc;
+    }
+
+    if (s->a_pending + size > SNIFF_PENDING_MAX) {
+        s->b2a.dropped += size;
+        return;
+    }
+
+    struct opq_item *itm = opq_acquire_tail(&opq_rt);
+    if (!itm) {
+        s->b2a.dropped += size;
+        return;
+    }
+
+    struct sniff_chunk *c = _chunk_new(data, size, ts);
+
+    // captured as B>A on read, see _on_b_readable()
+    itm->op_code = OP_PORT_WRITE;
+    itm->size = size;
+    itm->u.data = c->data;
+    itm->free_cb = _on_a_write_done;
+    itm->forwarded = true;
+
+    int err = opq_enqueue_tail(&opq_rt, itm);
+    assert(!err); // space checked by acquire
+
+    s->a_queued++;
+    s->a_pending += size;
+}
+
+static void _on_b_readable(void)
+{
+    struct sniff_s *s = &sniff_data;
+    static char buf[SNIFF_RDBUF_SIZE];
+
+    int rc = sp_nonblocking_read(s->port, buf, sizeof(buf));
+    if (rc < 0)
+        SPCOM_EXIT(EX_IOERR, "sniff port read - %s", misc_sp_err_to_str(rc));
+
+    if (rc == 0)
+        return; // EAGAIN
+
+    uint64_t ts = uv_hrtime();
+    capture_data(CAPTURE_TAG_B2A, buf, rc);
+    _forward_to_a(buf, rc, ts);
+}
+
+static void _uvcb_poll_event(uv_poll_t *handle, int status, int events)
+{
+    if (status == UV_EBADF)
+        SPCOM_EXIT(EX_OSFILE, "sniff port poll - %s", uv_strerror(status));
+
+    if (status) {
+        LOG_UV_ERR(status, "sniff port poll");
+        return;
+    }
+
+    if (events & UV_READABLE)
+        _on_b_readable();
+
+    if (events & UV_WRITABLE)
+        _on_b_writable();
+}
+
+static void _poll_start(int events)
+{
+    struct sniff_s *s = &sniff_data;
+
+    // calling uv_poll_start() on active handle updates events mask
+    int err = uv_poll_start(&s->poll_handle, events, _uvcb_poll_event);
+    assert_uv_ok(err, "uv_poll_start");
+}
+
+bool sniff_is_active(void)
+{
+    return sniff_data.initialized;
+}
+
+void sniff_init(void)
+{
+    struct sniff_s *s = &sniff_data;
+    int err;
+
+    if (!sniff_opts.name)
+        return;
+
+    err = sp_get_port_by_name(sniff_opts.name, &s->port);
+    if (err)
+        SPCOM_EXIT(EX_USAGE, "No such device '%s'", sniff_opts.name);
+
+    err = sp_open(s->port, SP_MODE_READ_WRITE);
+    assert_sp_ok(err, "sp_open");
+
+    err = sp_new_config(&s->org_config);
+    assert_sp_ok(err, "sp_new_config");
+
+    // get os defualts. must be _after_ open
+    err = sp_get_config(s->port, s->org_config);
+    assert_sp_ok(err, "sp_get_config");
+
+    // same settings as port A
+    err = port_apply_config(s->port, port_opts);
+    if (err)
+        SPCOM_EXIT(EX_USAGE, "Failed to configure '%s'", sniff_opts.name);
+
+    uv_os_fd_t fd = -1;
+    err = sp_get_port_handle(s->port, &fd);
+    assert_sp_ok(err, "sp_get_port_handle");
+
+    err = uv_poll_init(uv_default_loop(), &s->poll_handle, fd);
+    assert_uv_ok(err, "uv_poll_init");
+
+    s->initialized = true;
+    _poll_start(UV_READABLE);
+
+    LOG_INF("Sniffing %s <=> %s", port_opts->name, sniff_opts.name);
+}
+
+void sniff_cleanup(void)
+{
+    struct sniff_s *s = &sniff_data;
+    int err;
+
+    if (!s->initialized)
+        return;
+
+    s->initialized = false;
+
+    err = uv_poll_stop(&s->poll_handle);
+    (void)err;
+
+    while (s->head) {
+        struct sniff_chunk *c = s->head;
+        s->head = c->next;
+        s->a2b.dropped += c->size - c->offset;
+        free(c);
+    }
+    s->tail = NULL;
+
+    _stats_log(CAPTURE_TAG_A2B, &s->a2b);
+    _stats_log(CAPTURE_TAG_B2A, &s->b2a);
+
+    err = sp_set_config(s->port, s->org_config);
+    if (err)
+        LOG_DBG("failed to restore sniff port settings");
+
+    sp_free_config(s->org_config);
+    s->org_config = NULL;
+
+    err = sp_close(s->port);
+    if (err)
+        LOG_SP_ERR(err, "sp_close");
+
+    sp_free_port(s->port);
+    s->port = NULL;
+}
+
+static const struct opt_conf sniff_opts_conf[] = {
+    {
+        .name = "sniff",
+        .dest = &sniff_opts.name,
+        .parse = opt_parse_str,
+        .metavar = "PORT",
+        .descr = "man-in-the-middle mode. forward all data between port and "
+                 "this second port, using the same settings. Use with "
+                 "--capture to record both directions",
+    },
+};
+
+OPT_SECTION_ADD(sniff,
+                sniff_opts_conf,
+                ARRAY_LEN(sniff_opts_conf),
+                NULL);
@@ -0,0 +1,343 @@
+/**
+ * live session statistics. Counters are plain increments where the event
+ * happens, see stats.h, and only read here. Shown:
+ *
+ *  - on SIGUSR1, to stderr
+ *  - on exit with `--stats`
+ *  - once per second on the last terminal row with `--status-line`. Rest of
+ *    the terminal is set as scroll region so output does not overwrite it.
+ */
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+// deps
+#include <uv.h>
+// local
+#include "assert.h"
+#include "common.h"
+#include "log.h"
+#include "opq.h"
+#include "opt.h"
+#include "port.h"
+#include "port_thread.h"
+#include "shell.h"
+#include "stats.h"
+
+#define STATS_STATUS_MS 1000
+#define STATS_REPORT_SIZE 1024
+
+struct stats_s stats;
+
+static struct stats_opts_s {
+    int summary;
+    int status_line;
+} stats_opts;
+
+static struct stats_data_s {
+    bool initialized;
+    uv_signal_t sig;
+    uv_timer_t timer;
+    /// terminal rows when scroll region set, zero if not
+    unsigned int rows;
+    /// at previous status line, for rates
+    size_t rx_bytes;
+    size_t tx_bytes;
+} stats_data;
+
+struct stats_report {
+    size_t len;
+    char buf[STATS_REPORT_SIZE];
+};
+
+uint64_t stats_hist_quantile(const struct stats_hist *h, double q)
+{
+    if (!h->count)
+        return 0;
+
+    uint64_t rank = q * h->count;
+    uint64_t n = 0;
+
+    for (unsigned int i = 0; i < STATS_HIST_LEN; i++) {
+        n += h->buckets[i];
+        if (n <= rank)
+            continue;
+
+        if (i < STATS_HIST_SUB)
+            return i;
+
+        unsigned int shift = i / STATS_HIST_SUB - 1;
+        uint64_t v = (uint64_t)(STATS_HIST_SUB | (i % STATS_HIST_SUB)) << shift;
+        return (v < h->max) ? v : h->max;
+    }
+
+    return h->max;
+}
+
+static void _putf(struct stats_report *r, const char *fmt, ...)
+{
+    va_list args;
+    size_t space = sizeof(r->buf) - r->len;
+
+    va_start(args, fmt);
+    int rc = vsnprintf(&r->buf[r->len], space, fmt, args);
+    va_end(args);
+
+    if (rc > 0)
+        r->len += ((size_t)rc < space) ? (size_t)rc : space - 1;
+}
+
+static const char *_fmt_ns(char *buf, size_t size, uint64_t ns)
+{
+    if (ns < 1000)
+        snprintf(buf, size, "%u ns", (unsigned int)ns);
+    else if (ns < 1000000)
+        snprintf(buf, size, "%.1f us", ns / 1e3);
+    else if (ns < 1000000000)
+        snprintf(buf, size, "%.1f ms", ns / 1e6);
+    else
+        snprintf(buf, size, "%.1f s", ns / 1e9);
+
+    return buf;
+}
+
+static const char *_fmt_bytes(char *buf, size_t size, double n)
+{
+    if (n < 1024)
+        snprintf(buf, size, "%.0f B", n);
+    else if (n < 1024 * 1024)
+        snprintf(buf, size, "%.1f KiB", n / 1024);
+    else
+        snprintf(buf, size, "%.1f MiB", n / (1024 * 1024));
+
+    return buf;
+}
+
+static void _put_hist(struct stats_report *r, const char *name,
+                      const struct stats_hist *h, bool is_ns)
+{
+    char p50[16], p99[16], max[16];
+    uint64_t v[] = {
+        stats_hist_quantile(h, 0.5),
+        stats_hist_quantile(h, 0.99),
+        h->max,
+    };
+
+    if (!h->count) {
+        _putf(r, "  %-16s -\n", name);
+        return;
+    }
+
+    if (is_ns) {
+        _putf(r, "  %-16s p50 %s, p99 %s, max %s\n", name,
+              _fmt_ns(p50, sizeof(p50), v[0]), _fmt_ns(p99, sizeof(p99), v[1]),
+              _fmt_ns(max, sizeof(max), v[2]));
+        return;
+    }
+
+    _putf(r, "  %-16s p50 %llu, p99 %llu, max %llu\n", name,
+          (unsigned long long)v[0], (unsigned long long)v[1],
+          (unsigned long long)v[2]);
+}
+
+static void _report(void)
+{
+    const struct port_stats_s *ps = port_stats();
+    struct stats_report r = { 0 };
+    char t0[16], t1[16];
+
+    _putf(&r, "rx %zu bytes, %zu reads, %zu EAGAIN\n", ps->rx_bytes,
+          stats.rx_reads, stats.rx_eagain);
+    _put_hist(&r, "read size", &stats.read_size, false);
+    if (port_thread_is_enabled())
+        _putf(&r, "  port thread ring full %zu times\n",
+              __atomic_load_n(&stats.rx_ring_full, __ATOMIC_RELAXED));
+
+    _putf(&r, "tx %zu bytes, %zu writes, %zu EAGAIN, queue max %u\n",
+          ps->tx_bytes, stats.tx_writes, stats.tx_eagain,
+          opq_max_count(&opq_rt));
+    _put_hist(&r, "enqueue to wire", &stats.tx_latency, true);
+
+    _putf(&r, "stdout %zu bytes, %zu writes, blocked %s\n", stats.flush_bytes,
+          stats.flushes, _fmt_ns(t0, sizeof(t0), stats.stdout_ns));
+    _put_hist(&r, "read to display", &stats.rx_latency, true);
+
+    _putf(&r, "reconnects %zu, disconnected %s (longest %s)\n",
+          stats.reconnects, _fmt_ns(t0, sizeof(t0), stats.disconnected_ns),
+          _fmt_ns(t1, sizeof(t1), stats.disconnected_max_ns));
+
+    if (stats.modem_latency.count) {
+        _putf(&r, "modem %llu events\n",
+              (unsigned long long)stats.modem_latency.count);
+        _put_hist(&r, "wake to display", &stats.modem_latency, true);
+    }
+
+    if (ps->have_icount) {
+        _putf(&r, "uart");
+        for (int i = 0; i < PORT_ICOUNT_COUNT; i++)
+            _putf(&r, " %s %zu", port_icount_str(i), ps->icount[i]);
+        _putf(&r, "\n");
+    }
+
+    shell_write(STDERR_FILENO, r.buf, r.len);
+}
+
+static unsigned int _term_size(unsigned int *cols)
+{
+    struct winsize ws;
+
+    if (ioctl(STDERR_FILENO, TIOCGWINSZ, &ws) || ws.ws_row < 2)
+        return 0;
+
+    *cols = ws.ws_col;
+    return ws.ws_row;
+}
+
+/**
+ * scroll region all but last row. newline first in case cursor on last row.
+ * setting region moves cursor to home, hence save and restore
+ */
+static void _scroll_region_set(unsigned int rows)
+{
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\n\033[1A\0337\033[1;%ur\0338",
+                       rows - 1);
+
+    shell_write(STDERR_FILENO, buf, len);
+    stats_data.rows = rows;
+}
+
+static void _scroll_region_reset(void)
+{
+    char buf[32];
+
+    if (!stats_data.rows)
+        return;
+
+    int len = snprintf(buf, sizeof(buf), "\0337\033[r\033[%u;1H\033[2K\0338",
+                       stats_data.rows);
+
+    shell_write(STDERR_FILENO, buf, len);
+    stats_data.rows = 0;
+}
+
+static void _status_line_update(void)
+{
+    struct stats_data_s *sd = &stats_data;
+    const struct port_stats_s *ps = port_stats();
+    struct stats_report r = { 0 };
+    char rx[16], tx[16], lat[16];
+    unsigned int cols = 0;
+    unsigned int rows = _term_size(&cols);
+
+    if (!rows)
+        return;
+
+    if (rows != sd->rows)
+        _scroll_region_set(rows);
+
+    const double dt = STATS_STATUS_MS / 1000.0;
+    _putf(&r, "rx %s/s  tx %s/s  EAGAIN %zu/%zu  queue %u/%u  "
+              "reconnects %zu  read to display p99 %s",
+          _fmt_bytes(rx, sizeof(rx), (ps->rx_bytes - sd->rx_bytes) / dt),
+          _fmt_bytes(tx, sizeof(tx), (ps->tx_bytes - sd->tx_bytes) / dt),
+          stats.rx_eagain, stats.tx_eagain, opq_count(&opq_rt),
+          opq_max_count(&opq_rt), stats.reconnects,
+          _fmt_ns(lat, sizeof(lat),
+                  stats_hist_quantile(&stats.rx_latency, 0.99)));
+
+    if (ps->have_icount)
+        _putf(&r, "  overruns %zu",
+              ps->icount[PORT_ICOUNT_OVERRUN]
+                  + ps->icount[PORT_ICOUNT_BUF_OVERRUN]);
+
+    sd->rx_bytes = ps->rx_bytes;
+    sd->tx_bytes = ps->tx_bytes;
+
+    // ascii only, i.e. one column per byte
+    size_t len = (r.len < cols) ? r.len : cols;
+    char buf[STATS_REPORT_SIZE + 32];
+    int n = snprintf(buf, sizeof(buf), "\0337\033[%u;1H\033[2K%.*s\0338", rows,
+                     (int)len, r.buf);
+
+    shell_write(STDERR_FILENO, buf, n);
+}
+
+static void _on_timer(uv_timer_t *handle)
+{
+    _status_line_update();
+}
+
+static void _on_signal(uv_signal_t *handle, int signum)
+{
+    _report();
+}
+
+void stats_init(void)
+{
+    struct stats_data_s *sd = &stats_data;
+    uv_loop_t *loop = uv_default_loop();
+
+    int err = uv_signal_init(loop, &sd->sig);
+    assert_uv_ok(err, "uv_signal_init");
+    err = uv_signal_start(&sd->sig, _on_signal, SIGUSR1);
+    assert_uv_ok(err, "uv_signal_start");
+
+    sd->initialized = true;
+
+    if (!stats_opts.status_line)
+        return;
+
+    if (!isatty(STDERR_FILENO)) {
+        LOG_WRN("--status-line ignored, stderr not a terminal");
+        return;
+    }
+
+    err = uv_timer_init(loop, &sd->timer);
+    assert_uv_ok(err, "uv_timer_init");
+    err = uv_timer_start(&sd->timer, _on_timer, STATS_STATUS_MS,
+                         STATS_STATUS_MS);
+    assert_uv_ok(err, "uv_timer_start");
+}
+
+void stats_cleanup(void)
+{
+    struct stats_data_s *sd = &stats_data;
+
+    if (!sd->initialized)
+        return;
+
+    // handles closed by main_uv_cleanup()
+    _scroll_region_reset();
+
+    if (stats_opts.summary)
+        _report();
+
+    sd->initialized = false;
+}
+
+static const struct opt_conf stats_opts_conf[] = {
+    {
+        .name = "stats",
+        .dest = &stats_opts.summary,
+        .parse = opt_parse_flag_true,
+        .descr = "print session statistics to stderr on exit. Also printed on "
+                 "SIGUSR1, e.g. `kill -USR1 $(pidof spcom)`",
+    },
+    {
+        .name = "status-line",
+        .dest = &stats_opts.status_line,
+        .parse = opt_parse_flag_true,
+        .descr = "show rates, queue depth and latency on last terminal row, "
+                 "updated every second",
+    },
+};
+
+OPT_SECTION_ADD(stats,
+                stats_opts_conf,
+                ARRAY_LEN(stats_opts_conf),
+                NULL);
@@ -6,6 +6,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 // local
 #include "assert.h"
 #include "common.h"
@@ -413,3 +416,44 @@ int str_iso8601_short(char *dst, size_t size)
 
     return len;
 }
+
+const char *str_memmem(const char *hay, size_t hlen, const char *needle,
+                       size_t nlen)
+{
+    if (nlen == 0)
+        return hay;
+
+    if (nlen > hlen)
+        return NULL;
+
+    if (nlen == 1)
+        return memchr(hay, needle[0], hlen);
+
+#ifdef __SSE2__
+    /* compare first and last byte of needle at 16 positions at once and only
+     * memcmp the candidates. see http://0x80.pl/articles/simd-strfind.html */
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+    size_t i = 0;
+
+    for (; i + nlen - 1 + 16 <= hlen; i += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i bl = _mm_loadu_si128((const __m128i *)(hay + i + nlen - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, bf),
+                                   _mm_cmpeq_epi8(last, bl));
+        unsigned int mask = _mm_movemask_epi8(eq);
+
+        while (mask) {
+            unsigned int bit = __builtin_ctz(mask);
+            if (!memcmp(hay + i + bit + 1, needle + 1, nlen - 2))
+                return hay + i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    // remaining positions
+    hay += i;
+    hlen -= i;
+#endif
+    return memmem(hay, hlen, needle, nlen);
+}
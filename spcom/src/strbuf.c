@@ -14,7 +14,7 @@ void strbuf_write(struct strbuf *sb, const char *src, size_t size)
         size_t max_size = strbuf_remains(sb);
         size_t chunk_size = (size <= max_size) ? size : max_size;
 
-        memcpy(&sb->buf[sb->len], src, size);
+        memcpy(&sb->buf[sb->len], src, chunk_size);
         sb->len += chunk_size;
 
         if (chunk_size >= size) {
@@ -0,0 +1,265 @@
+/**
+ * binary event trace, i.e. a flight recorder for latency issues. Events are
+ * fixed size records in a ring per thread, oldest overwritten. Recording is
+ * a clock read and a store, no locks. Rings are written to `--trace FILE` as
+ * Chrome trace JSON on exit and on SIGUSR2, and can be opened in
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * On x86 the clock is the time stamp counter, converted to ns when written
+ * using the monotonic clock at start and at time of writing. Assumes
+ * invariant TSC, i.e. anything from the last decade.
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+// deps
+#include <uv.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_USE_TSC 1
+#else
+#define TRACE_USE_TSC 0
+#endif
+// local
+#include "assert.h"
+#include "common.h"
+#include "log.h"
+#include "opt.h"
+#include "trace.h"
+
+/// records per thread. power of two
+#define TRACE_RING_LEN (64 * 1024)
+
+struct trace_rec {
+    /// ticks, see _now()
+    uint64_t ts;
+    uint32_t arg;
+    uint32_t event;
+};
+
+struct trace_ring {
+    struct trace_ring *next;
+    unsigned int tid;
+    /// total records, i.e. next index
+    uint64_t n;
+    struct trace_rec recs[TRACE_RING_LEN];
+};
+
+static struct trace_opts_s {
+    const char *file;
+} trace_opts;
+
+static struct trace_s {
+    uv_signal_t sig;
+    /// ticks and ns at start
+    uint64_t t_start;
+    uint64_t ns_start;
+    /// ns per tick
+    double ns_per_tick;
+    pthread_mutex_t lock;
+    /// all rings, one per thread
+    struct trace_ring *rings;
+    unsigned int nthreads;
+} trace_data = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static __thread struct trace_ring *trace_ring;
+
+bool trace_on;
+
+static const char *trace_event_str[TRACE_EVENT_COUNT] = {
+    [TRACE_PORT_POLL] = "port_poll",
+    [TRACE_PORT_READ] = "port_read",
+    [TRACE_PORT_WRITE] = "port_write",
+    [TRACE_PORT_EAGAIN] = "port_eagain",
+    [TRACE_OPQ_ENQUEUE] = "opq_enqueue",
+    [TRACE_OPQ_DEQUEUE] = "opq_dequeue",
+    [TRACE_OUTFMT_FLUSH] = "outfmt_flush",
+    [TRACE_TIMER] = "timer",
+    [TRACE_SHELL_REDRAW] = "shell_redraw",
+};
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static inline uint64_t _now(void)
+{
+#if TRACE_USE_TSC
+    return __rdtsc();
+#else
+    return _now_ns();
+#endif
+}
+
+static void _calibrate(void)
+{
+    struct trace_s *td = &trace_data;
+#if TRACE_USE_TSC
+    uint64_t ticks = __rdtsc() - td->t_start;
+    uint64_t ns = _now_ns() - td->ns_start;
+    td->ns_per_tick = ticks ? (double)ns / ticks : 1.0;
+#else
+    td->ns_per_tick = 1.0;
+#endif
+}
+
+/// first event on a thread
+static struct trace_ring *_ring_new(void)
+{
+    struct trace_s *td = &trace_data;
+    struct trace_ring *r = calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+
+    pthread_mutex_lock(&td->lock);
+    r->tid = td->nthreads++;
+    r->next = td->rings;
+    td->rings = r;
+    pthread_mutex_unlock(&td->lock);
+
+    return r;
+}
+
+void trace_record(enum trace_event event, uint32_t arg)
+{
+    struct trace_ring *r = trace_ring;
+
+    if (!r) {
+        r = trace_ring = _ring_new();
+        if (!r)
+            return;
+    }
+
+    struct trace_rec *rec = &r->recs[r->n & (TRACE_RING_LEN - 1)];
+    rec->ts = _now();
+    rec->arg = arg;
+    rec->event = event;
+    r->n++;
+}
+
+static void _dump_ring(FILE *fp, const struct trace_ring *r, int pid,
+                       bool *first)
+{
+    const struct trace_s *td = &trace_data;
+    uint64_t n = r->n;
+    uint64_t i = (n > TRACE_RING_LEN) ? n - TRACE_RING_LEN : 0;
+
+    for (; i < n; i++) {
+        const struct trace_rec *rec = &r->recs[i & (TRACE_RING_LEN - 1)];
+        if (rec->event >= TRACE_EVENT_COUNT || rec->ts < td->t_start)
+            continue;
+
+        uint64_t ns = (rec->ts - td->t_start) * td->ns_per_tick;
+        fprintf(fp,
+                "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+                "\"ts\":%" PRIu64 ".%03u,\"pid\":%d,\"tid\":%u,"
+                "\"args\":{\"arg\":%" PRIu32 "}}",
+                *first ? "" : ",\n", trace_event_str[rec->event],
+                ns / 1000, (unsigned int)(ns % 1000), pid, r->tid, rec->arg);
+        *first = false;
+    }
+}
+
+static void _dump(void)
+{
+    struct trace_s *td = &trace_data;
+
+    FILE *fp = fopen(trace_opts.file, "w");
+    if (!fp) {
+        LOG_ERR("trace file %s '%s'", trace_opts.file, strerror(errno));
+        return;
+    }
+
+    int pid = getpid();
+    bool first = true;
+
+    _calibrate();
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", fp);
+
+    pthread_mutex_lock(&td->lock);
+    for (const struct trace_ring *r = td->rings; r; r = r->next)
+        _dump_ring(fp, r, pid, &first);
+    pthread_mutex_unlock(&td->lock);
+
+    fputs("\n]}\n", fp);
+    fclose(fp);
+
+    LOG_INF("trace written to %s", trace_opts.file);
+}
+
+static void _on_signal(uv_signal_t *handle, int signum)
+{
+    _dump();
+}
+
+void trace_init(void)
+{
+    struct trace_s *td = &trace_data;
+
+    if (!trace_opts.file)
+        return;
+
+#if !CONFIG_TRACE
+    LOG_WRN("trace points not in this build");
+#endif
+
+    td->ns_start = _now_ns();
+    td->t_start = _now();
+    trace_on = true;
+
+    int err = uv_signal_init(uv_default_loop(), &td->sig);
+    assert_uv_ok(err, "uv_signal_init");
+    err = uv_signal_start(&td->sig, _on_signal, SIGUSR2);
+    assert_uv_ok(err, "uv_signal_start");
+}
+
+void trace_cleanup(void)
+{
+    struct trace_s *td = &trace_data;
+
+    if (!trace_on)
+        return;
+
+    trace_on = false;
+    _dump();
+
+    // other threads done. see main_cleanup()
+    pthread_mutex_lock(&td->lock);
+    while (td->rings) {
+        struct trace_ring *r = td->rings;
+        td->rings = r->next;
+        free(r);
+    }
+    pthread_mutex_unlock(&td->lock);
+    trace_ring = NULL;
+}
+
+static const struct opt_conf trace_opts_conf[] = {
+    {
+        .name = "trace",
+        .dest = &trace_opts.file,
+        .parse = opt_parse_str,
+        .metavar = "FILE",
+        .descr = "record port, queue, output and timer events. Written to "
+                 "FILE as Chrome trace JSON on exit or SIGUSR2",
+    },
+};
+
+OPT_SECTION_ADD(trace,
+                trace_opts_conf,
+                ARRAY_LEN(trace_opts_conf),
+                NULL);
@@ -0,0 +1,256 @@
+/**
+ * keyword triggers on received data, e.g. "panic", "HardFault" or "assert".
+ *
+ * All trigger patterns are compiled into a single Aho-Corasick automaton, see
+ * acmatch.h, so the cost per received byte does not depend on the number of
+ * triggers. Trigger format, quoted as shell commands:
+ *
+ *     PATTERN [ACTION ...]
+ *
+ * actions:
+ *   - `count`     report number of matches on exit (default if no action)
+ *   - `highlight` color the match in output. Not with --frame, i.e. match is
+ *     in raw data, not in decoded frames
+ *   - `mark`      write a marker to the capture file
+ *   - `exit=CODE` exit with CODE instead of zero (highest code wins)
+ *   - `run CMD`   run shell command. pattern passed as `$1`. Not started
+ *                 again until previous run of same trigger has exited.
+ */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+// deps
+#include <uv.h>
+// local
+#include "acmatch.h"
+#include "assert.h"
+#include "capture.h"
+#include "common.h"
+#include "log.h"
+#include "opt.h"
+#include "outfmt.h"
+#include "str.h"
+#include "strto.h"
+#include "trigger.h"
+#include "vt_defs.h"
+
+#define TRIGGER_F_COUNT (1 << 0)
+#define TRIGGER_F_HIGHLIGHT (1 << 1)
+#define TRIGGER_F_MARK (1 << 2)
+
+struct trigger {
+    /// owned (strdup) as options parsed before init
+    char *pattern;
+    char *run;
+    unsigned int flags;
+    int exit_code;
+    size_t count;
+    bool running;
+};
+
+static struct trigger_s {
+    struct trigger *triggers;
+    int ntriggers;
+    struct acmatch *ac;
+    int exit_code;
+} trigger_data;
+
+int trigger_exit_code(void)
+{
+    return trigger_data.exit_code;
+}
+
+static void _on_run_close(uv_handle_t *handle)
+{
+    free(handle);
+}
+
+static void _on_run_exit(uv_process_t *proc, int64_t exit_status,
+                         int term_signal)
+{
+    struct trigger *t = proc->data;
+
+    LOG_DBG("trigger '%s' run exit %d", t->pattern, (int)exit_status);
+    t->running = false;
+    uv_close((uv_handle_t *)proc, _on_run_close);
+}
+
+static void _run(struct trigger *t)
+{
+    if (t->running)
+        return;
+
+    uv_process_t *proc = malloc(sizeof(*proc));
+    assert(proc);
+
+    char *args[] = { "/bin/sh", "-c", t->run, "sh", t->pattern, NULL };
+    uv_process_options_t options = {
+        .file = args[0],
+        .args = args,
+        .exit_cb = _on_run_exit,
+    };
+
+    proc->data = t;
+    int err = uv_spawn(uv_default_loop(), proc, &options);
+    if (err) {
+        LOG_UV_ERR(err, "trigger run");
+        free(proc);
+        return;
+    }
+
+    t->running = true;
+}
+
+static void _on_match(int id, size_t end, void *arg)
+{
+    struct trigger *t = &trigger_data.triggers[id];
+
+    t->count++;
+
+    if (t->flags & TRIGGER_F_HIGHLIGHT) {
+        // match could have started in previous chunk
+        size_t len = acmatch_pattern_len(trigger_data.ac, id);
+        size_t start = (end > len) ? end - len : 0;
+        outfmt_mark(start, end, VT_COLOR_HIGHLIGHT);
+    }
+
+    if (t->flags & TRIGGER_F_MARK)
+        capture_event(CAPTURE_TAG_EVT, "trigger '%s'", t->pattern);
+
+    if (t->exit_code > trigger_data.exit_code)
+        trigger_data.exit_code = t->exit_code;
+
+    if (t->run)
+        _run(t);
+}
+
+void trigger_feed(const void *data, size_t size)
+{
+    if (!trigger_data.ac)
+        return;
+
+    acmatch_feed(trigger_data.ac, data, size, _on_match, NULL);
+}
+
+void trigger_init(void)
+{
+    struct trigger_s *td = &trigger_data;
+
+    if (!td->ntriggers)
+        return;
+
+    td->ac = acmatch_new();
+
+    for (int i = 0; i < td->ntriggers; i++) {
+        const char *pattern = td->triggers[i].pattern;
+        int id = acmatch_add(td->ac, pattern, strlen(pattern));
+        assert(id == i);
+    }
+
+    int err = acmatch_compile(td->ac);
+    if (err)
+        SPCOM_EXIT(EX_USAGE, "triggers - %s", strerror(-err));
+
+    LOG_DBG("%d triggers", td->ntriggers);
+}
+
+void trigger_cleanup(void)
+{
+    struct trigger_s *td = &trigger_data;
+
+    for (int i = 0; i < td->ntriggers; i++) {
+        struct trigger *t = &td->triggers[i];
+        if (t->flags & TRIGGER_F_COUNT)
+            LOG_INF("trigger '%s' matched %zu times", t->pattern, t->count);
+    }
+
+    acmatch_free(td->ac);
+    td->ac = NULL;
+    // triggers kept. running processes might reference them
+}
+
+/// @param s modified
+static int _parse_trigger(char *s)
+{
+    struct trigger t = { 0 };
+    int argc = 0;
+    char *argv[16];
+
+    int err = str_split_quoted(s, &argc, argv, ARRAY_LEN(argv));
+    if (err || argc < 1 || argv[0][0] == '\0')
+        return -EINVAL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (!strcmp(a, "count")) {
+            t.flags |= TRIGGER_F_COUNT;
+        }
+        else if (!strcmp(a, "highlight")) {
+            t.flags |= TRIGGER_F_HIGHLIGHT;
+        }
+        else if (!strcmp(a, "mark")) {
+            t.flags |= TRIGGER_F_MARK;
+        }
+        else if (str_startswith(a, "exit=")) {
+            err = strto_i(a + strlen("exit="), NULL, 0, &t.exit_code);
+            if (err || t.exit_code < 0 || t.exit_code > 255)
+                return -EINVAL;
+        }
+        else if (!strcmp(a, "run") && i + 1 < argc) {
+            t.run = strdup(argv[++i]);
+            assert(t.run);
+        }
+        else {
+            return -EINVAL;
+        }
+    }
+
+    if (!t.flags && !t.exit_code && !t.run)
+        t.flags = TRIGGER_F_COUNT;
+
+    t.pattern = strdup(argv[0]);
+    assert(t.pattern);
+
+    struct trigger_s *td = &trigger_data;
+    td->triggers = realloc(td->triggers,
+                           (td->ntriggers + 1) * sizeof(*td->triggers));
+    assert(td->triggers);
+    td->triggers[td->ntriggers++] = t;
+
+    return 0;
+}
+
+static int _parse_cb_trigger(const struct opt_conf *conf, char *sval)
+{
+    if (_parse_trigger(sval))
+        return opt_perror(conf, "invalid trigger");
+
+    return 0;
+}
+
+static int _parse_cb_trigger_file(const struct opt_conf *conf, char *sval)
+{
+    return opt_parse_file_lines(conf, sval, _parse_trigger);
+}
+
+static const struct opt_conf trigger_opts_conf[] = {
+    {
+        .name = "trigger",
+        .parse = _parse_cb_trigger,
+        .metavar = "\"PATTERN [ACTION...]\"",
+        .descr = "action(s) on received keyword. Actions: count, highlight, "
+                 "mark, exit=CODE, run CMD. Can be repeated",
+    },
+    {
+        .name = "trigger-file",
+        .parse = _parse_cb_trigger_file,
+        .metavar = "FILE",
+        .descr = "read triggers from file. One per line, same format as "
+                 "--trigger. Lines starting with '#' ignored",
+    },
+};
+
+OPT_SECTION_ADD(trigger,
+                trigger_opts_conf,
+                ARRAY_LEN(trigger_opts_conf),
+                NULL);
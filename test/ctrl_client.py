@@ -0,0 +1,65 @@
+"""
+control socket test. Requires a virtual serial port pair (see
+linux/README.md), e.g. tty0tty /dev/tnt0 <=> /dev/tnt1
+
+    spcom /dev/tnt0 --ctrl-socket /tmp/spcom.sock
+    python3 ctrl_client.py
+"""
+import socket
+import sys
+# non std deps
+import serial
+
+DEFAULT_PATH = "/tmp/spcom.sock"
+DEFAULT_PEER = "/dev/tnt1"
+
+def request(f, line):
+    f.write(line + "\n")
+    f.flush()
+    reply = f.readline().strip()
+    print(f"{line!r} -> {reply!r}")
+    return reply
+
+def run(path=None, peer=None):
+
+    if path is None:
+        path = DEFAULT_PATH
+    if peer is None:
+        peer = DEFAULT_PEER
+
+    with serial.Serial(peer, baudrate=9600, timeout=2) as ser_peer, \
+         socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+
+        sock.connect(path)
+        f = sock.makefile("rw")
+
+        if not request(f, "state").startswith("OK 1 "):
+            return 1
+
+        # reply sent when written, i.e. data available on peer
+        if request(f, "send -n -x 00 ff 0a") != "OK 2":
+            return 1
+        rx = ser_peer.read(3)
+        if rx != b"\x00\xff\x0a":
+            print("FAIL: send", rx.hex())
+            return 1
+
+        if request(f, "sleep 0.2") != "OK 3":
+            return 1
+
+        if not request(f, "nosuchcmd").startswith("ERR 4 "):
+            return 1
+
+        if not request(f, "stats").startswith("OK 5 "):
+            return 1
+
+    print("OK")
+    return 0
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else None
+    peer = sys.argv[2] if len(sys.argv) > 2 else None
+    sys.exit(run(path, peer))
+
+if __name__ == '__main__':
+    main()
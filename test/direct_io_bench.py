@@ -0,0 +1,109 @@
+"""
+Cost of port reads and writes with libserialport and with `--direct-io`,
+over a pty pair. spcom CPU time (user + sys) is divided by number of read
+or write calls, from the `--stats` summary, and by MiB transferred, e.g.
+
+    python3 direct_io_bench.py --spcom ../spcom/build/spcom --chunk 64
+
+Small `--chunk` gives one call per chunk, i.e. per call overhead. Large
+chunks show cost per MiB. CPU time includes everything else spcom does, so
+compare backends, not absolute numbers.
+"""
+import argparse
+import os
+import re
+import subprocess
+import threading
+import time
+
+from spcom_pty import SpcomPty
+
+
+def spawn(args, extra, **kwargs):
+    return SpcomPty(args.spcom, ["--raw-out", "--stats"] + extra,
+                    stderr=subprocess.PIPE, **kwargs)
+
+
+def read_n(fd, n, timeout):
+    got = 0
+    deadline = time.monotonic() + timeout
+    while got < n and time.monotonic() < deadline:
+        got += len(os.read(fd, 65536))
+    return got
+
+
+def write_chunks(fd, data, chunk):
+    for i in range(0, len(data), chunk):
+        os.write(fd, data[i:i + chunk])
+
+
+def finish(proc, regex):
+    # rusage of spcom only
+    _, status, ru = os.wait4(proc.pid, 0)
+    proc.returncode = status
+    err = proc.stderr.read().decode(errors="replace")
+    m = re.search(regex, err)
+    calls = int(m.group(1)) if m else 0
+    return calls, ru.ru_utime + ru.ru_stime
+
+
+def run_rx(args, extra, data):
+    with spawn(args, extra, stdout=subprocess.PIPE) as pty:
+        t0 = time.perf_counter()
+        w = threading.Thread(target=write_chunks,
+                             args=(pty.master, data, args.chunk))
+        w.start()
+        got = read_n(pty.proc.stdout.fileno(), len(data), args.timeout)
+        wall = time.perf_counter() - t0
+        w.join()
+
+        pty.interrupt()
+        calls, cpu = finish(pty.proc, r"rx \d+ bytes, (\d+) reads")
+    return got, calls, cpu, wall
+
+
+def run_tx(args, extra, data):
+    with spawn(args, extra, stdout=subprocess.DEVNULL) as pty:
+        proc = pty.proc
+
+        def writer():
+            write_chunks(proc.stdin.fileno(), data, args.chunk)
+            proc.stdin.close()
+
+        t0 = time.perf_counter()
+        w = threading.Thread(target=writer)
+        w.start()
+        got = read_n(pty.master, len(data), args.timeout)
+        wall = time.perf_counter() - t0
+        w.join()
+
+        # exits on stdin closed
+        calls, cpu = finish(proc, r"tx \d+ bytes, (\d+) writes")
+    return got, calls, cpu, wall
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--spcom", default="spcom")
+    parser.add_argument("--size", type=int, default=16, help="MiB")
+    parser.add_argument("--chunk", type=int, default=4096)
+    parser.add_argument("--timeout", type=float, default=60.0)
+    args = parser.parse_args()
+
+    # printable, no line ends. TX from stdin is line based
+    data = bytes(0x61 + (i % 26) for i in range(args.size << 20))
+
+    print("%-12s %-3s %10s %10s %12s %12s" %
+          ("backend", "dir", "MiB/s", "calls", "us/call", "ms/MiB"))
+    for name, extra in (("libserial", []), ("direct-io", ["--direct-io"])):
+        for d, fn in (("rx", run_rx), ("tx", run_tx)):
+            got, calls, cpu, wall = fn(args, extra, data)
+            mib = got / (1 << 20)
+            print("%-12s %-3s %10.1f %10d %12.2f %12.2f" %
+                  (name, d, mib / wall, calls,
+                   1e6 * cpu / calls if calls else 0,
+                   1e3 * cpu / mib if mib else 0))
+
+
+if __name__ == '__main__':
+    main()
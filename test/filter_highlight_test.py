@@ -0,0 +1,70 @@
+"""
+`--filter` together with `--highlight`. Filters match received bytes, i.e.
+not the color escapes inserted by a highlight inside the filter pattern. Lines
+are written to a pty, spcom output compared with the expected lines, e.g.
+
+    python3 filter_highlight_test.py --spcom ../spcom/build/spcom
+
+Exit status non-zero on mismatch.
+"""
+import argparse
+import os
+import re
+import subprocess
+import sys
+import time
+
+from spcom_pty import SpcomPty
+
+LINES = [
+    b"boot ok",
+    b"ERROR one",
+    b"not this",
+    b"an ERROR two",
+    b"ERR but not a match",
+]
+
+EXPECTED = [
+    b"ERROR one",
+    b"an ERROR two",
+]
+
+# CSI sequences and readline prompt ignore markers, see vt_defs.h
+ESCAPES = re.compile(rb"\x01|\x02|\x1b\[[0-9;]*m")
+
+
+def run(args, extra):
+    # "ER" highlighted, i.e. escapes inside "ERROR"
+    with SpcomPty(args.spcom,
+                  ["--highlight", "ER red", "--filter", "ERROR"] + extra,
+                  stdout=subprocess.PIPE, stderr=subprocess.DEVNULL) as pty:
+        for line in LINES:
+            os.write(pty.master, line + b"\n")
+        time.sleep(args.wait)
+
+        pty.interrupt()
+        out, _ = pty.proc.communicate(timeout=5)
+
+    lines = ESCAPES.sub(b"", out).replace(b"\r", b"").split(b"\n")
+    return [line for line in lines if line]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--spcom", default="spcom")
+    parser.add_argument("--wait", type=float, default=0.5,
+                        help="seconds to wait for output")
+    args = parser.parse_args()
+
+    failed = 0
+    for name, extra in (("plain", []), ("color", ["--color"])):
+        got = run(args, extra)
+        ok = got == EXPECTED
+        failed += not ok
+        print("%-6s %s" % (name, "ok" if ok else "FAIL %r" % got))
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
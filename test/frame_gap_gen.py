@@ -0,0 +1,82 @@
+"""
+PTY based generator for testing `--frame gap`.
+
+Frames are written with an idle gap of `2 * GAP` between them, and split in
+two writes with a pause of `GAP / 2` inside the frame, that must not end the
+frame. Run spcom on the printed pty path, e.g.
+
+    python3 frame_gap_gen.py --gap 5000 &
+    spcom --frame gap --frame-gap 5000 --capture /tmp/cap.txt /dev/pts/N
+
+and verify the capture file after the generator is done:
+
+    python3 frame_gap_gen.py --check /tmp/cap.txt
+"""
+import argparse
+import os
+import random
+import sys
+import time
+
+from spcom_pty import open_pty
+
+SEED = 1234
+
+
+def frames(count):
+    rnd = random.Random(SEED)
+    for i in range(count):
+        n = rnd.randint(2, 64)
+        yield bytes(rnd.randrange(256) for _ in range(n))
+
+
+def generate(count, gap_us, delay):
+    master, slave = open_pty()
+    print(os.ttyname(slave), flush=True)
+    time.sleep(delay)
+
+    gap = gap_us / 1e6
+    for data in frames(count):
+        half = len(data) // 2
+        os.write(master, data[:half])
+        time.sleep(gap / 2)
+        os.write(master, data[half:])
+        time.sleep(gap * 2)
+
+    print("sent", count, "frames", flush=True)
+    time.sleep(1)
+
+
+def check(path, count):
+    got = []
+    with open(path) as f:
+        for line in f:
+            parts = line.split()
+            if len(parts) >= 3 and parts[1] == "FRM":
+                got.append(bytes.fromhex("".join(parts[2:])))
+
+    expected = list(frames(count))
+    bad = sum(1 for a, b in zip(got, expected) if a != b)
+    bad += abs(len(got) - len(expected))
+    print("frames expected", len(expected), "got", len(got), "mismatch", bad)
+    return 1 if bad else 0
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--gap", type=int, default=5000, help="gap in us")
+    parser.add_argument("--count", type=int, default=100)
+    parser.add_argument("--delay", type=float, default=3.0,
+                        help="seconds to wait for spcom to open pty")
+    parser.add_argument("--check", metavar="CAPTURE",
+                        help="verify capture file instead of generating")
+    args = parser.parse_args()
+
+    if args.check:
+        sys.exit(check(args.check, args.count))
+
+    generate(args.count, args.gap, args.delay)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,111 @@
+"""
+Data loss under terminal stalls, with and without `--io-thread`. Data is
+written to a pty at a fixed rate (3 Mbaud by default) while spcom stdout,
+a pipe, is not read for `--stall` ms every `--period` seconds, as a
+terminal that is scrolled back or a slow ssh link. E.g.
+
+    python3 io_thread_bench.py --spcom ../spcom/build/spcom
+
+A pty has no UART FIFO, so writes that would block are counted as overrun,
+i.e. bytes a UART would have lost because spcom did not read in time.
+Output is compared with data sent.
+"""
+import argparse
+import fcntl
+import os
+import shlex
+import subprocess
+import threading
+import time
+
+from spcom_pty import SpcomPty
+
+CHUNK = 256
+
+
+class Reader(threading.Thread):
+    def __init__(self, fd, args):
+        super().__init__(daemon=True)
+        self.fd = fd
+        self.args = args
+        self.data = bytearray()
+        self.done = False
+
+    def run(self):
+        next_stall = time.monotonic() + self.args.period
+        while not self.done:
+            if time.monotonic() >= next_stall:
+                time.sleep(self.args.stall / 1000.0)
+                next_stall = time.monotonic() + self.args.period
+            try:
+                b = os.read(self.fd, 65536)
+            except BlockingIOError:
+                time.sleep(0.001)
+                continue
+            if not b:
+                break
+            self.data += b
+
+
+def run(args, extra):
+    pty = SpcomPty(args.spcom, ["--raw-out"] + shlex.split(extra),
+                   stdout=subprocess.PIPE)
+    master = pty.master
+    out = pty.proc.stdout.fileno()
+    os.set_blocking(out, False)
+
+    reader = Reader(out, args)
+    reader.start()
+
+    fcntl.fcntl(master, fcntl.F_SETFL,
+                fcntl.fcntl(master, fcntl.F_GETFL) | os.O_NONBLOCK)
+
+    rate = args.baud / 10  # 8N1
+    data = os.urandom(int(rate * args.time))
+    sent = bytearray()
+    overrun = 0
+    t0 = time.monotonic()
+    for i in range(0, len(data), CHUNK):
+        # pace to line rate
+        delay = t0 + i / rate - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+        chunk = data[i:i + CHUNK]
+        try:
+            n = os.write(master, chunk)
+        except BlockingIOError:
+            n = 0
+        sent += chunk[:n]
+        overrun += len(chunk) - n
+
+    time.sleep(args.stall / 1000.0 + 1.0)
+    reader.done = True
+    pty.close()
+    reader.join(1.0)
+
+    return len(data), overrun, reader.data == sent
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--spcom", default="spcom")
+    parser.add_argument("--baud", type=int, default=3000000)
+    parser.add_argument("--time", type=float, default=10.0,
+                        help="seconds to send")
+    parser.add_argument("--stall", type=float, default=500,
+                        help="ms stdout not read")
+    parser.add_argument("--period", type=float, default=2.0,
+                        help="seconds between stalls")
+    parser.add_argument("--args", default="",
+                        help="other spcom options, used in both runs")
+    args = parser.parse_args()
+
+    for name, extra in (("default", args.args),
+                        ("io-thread", args.args + " --io-thread")):
+        total, overrun, ok = run(args, extra)
+        print("%-10s sent %d bytes, overrun %d, output %s" %
+              (name, total, overrun, "ok" if ok else "MISMATCH"))
+
+
+if __name__ == '__main__':
+    main()
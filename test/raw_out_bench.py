@@ -0,0 +1,76 @@
+"""
+Throughput of `--raw-out` passthrough. Random data is written to a pty that
+spcom reads, with stdout redirected to a file, e.g.
+
+    python3 raw_out_bench.py --spcom ../spcom/build/spcom --size 64
+
+The output file is compared with data sent, and throughput is shown next to a
+plain memory copy of the same data as reference.
+
+Other options to spcom given with `--args`, e.g. cost of RX path with log
+level, or a build with other CONFIG_LOG_LEVEL:
+
+    python3 raw_out_bench.py --args="--raw-out --loglevel 4 --logfile /tmp/l"
+
+Output only equals data sent with `--raw-out`.
+
+A pty never drops data, so changes to the RX path should also be checked
+on a UART at high baud. `--stats` prints kernel overrun counters on exit,
+and with `--mark-errors` the output shows where they occurred.
+"""
+import argparse
+import os
+import shlex
+import sys
+import tempfile
+import time
+
+from spcom_pty import SpcomPty
+
+CHUNK = 4096
+
+
+def memcpy_rate(data):
+    t0 = time.perf_counter()
+    for _ in range(10):
+        bytearray(data)
+    return 10 * len(data) / (time.perf_counter() - t0)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--spcom", default="spcom")
+    parser.add_argument("--size", type=int, default=16, help="MiB to send")
+    parser.add_argument("--timeout", type=float, default=60.0)
+    parser.add_argument("--args", default="--raw-out",
+                        help="spcom options. Default: %(default)s")
+    args = parser.parse_args()
+
+    data = os.urandom(args.size << 20)
+    out = tempfile.NamedTemporaryFile(prefix="spcom_raw_")
+
+    with SpcomPty(args.spcom, shlex.split(args.args), stdout=out) as pty:
+        t0 = time.perf_counter()
+        for i in range(0, len(data), CHUNK):
+            os.write(pty.master, data[i:i + CHUNK])
+
+        deadline = time.monotonic() + args.timeout
+        while os.path.getsize(out.name) < len(data):
+            if time.monotonic() > deadline or pty.proc.poll() is not None:
+                break
+            time.sleep(0.001)
+        elapsed = time.perf_counter() - t0
+
+    with open(out.name, "rb") as f:
+        got = f.read()
+
+    ok = got == data
+    print("sent %d MiB, got %d bytes, %s" % (args.size, len(got),
+                                            "ok" if ok else "MISMATCH"))
+    print("spcom  %.1f MiB/s" % (len(got) / elapsed / (1 << 20)))
+    print("memcpy %.1f MiB/s" % (memcpy_rate(data) / (1 << 20)))
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
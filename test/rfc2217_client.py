@@ -0,0 +1,63 @@
+"""
+loopback test of spcom rfc2217 server mode. Requires a virtual serial port
+pair (see linux/README.md), e.g. tty0tty /dev/tnt0 <=> /dev/tnt1
+
+    spcom /dev/tnt0 --rfc2217 7000
+    python3 rfc2217_client.py
+"""
+import sys
+import time
+# non std deps
+import serial
+
+DEFAULT_URL = "rfc2217://localhost:7000"
+DEFAULT_PEER = "/dev/tnt1"
+
+def run(url=None, peer=None):
+
+    if url is None:
+        url = DEFAULT_URL
+    if peer is None:
+        peer = DEFAULT_PEER
+
+    # all bytes incl IAC (0xFF) that must be escaped
+    data = bytes(range(256))
+
+    with serial.Serial(peer, baudrate=9600, timeout=1) as ser_peer, \
+         serial.serial_for_url(url, baudrate=9600, timeout=1) as ser:
+
+        # settings negotiated through rfc2217 and applied on server side
+        ser.baudrate = 115200
+        ser.parity = serial.PARITY_EVEN
+        ser.parity = serial.PARITY_NONE
+        ser.rts = False
+        ser.dtr = True
+        ser_peer.baudrate = 115200
+
+        # client -> spcom -> serial port
+        ser.write(data)
+        rx = ser_peer.read(len(data))
+        if rx != data:
+            print("FAIL: client to port", rx.hex())
+            return 1
+
+        # serial port -> spcom -> client
+        ser_peer.write(data)
+        rx = ser.read(len(data))
+        if rx != data:
+            print("FAIL: port to client", rx.hex())
+            return 1
+
+        ser.reset_input_buffer()
+        time.sleep(0.1)
+
+    print("OK")
+    return 0
+
+def main():
+    url = sys.argv[1] if len(sys.argv) > 1 else None
+    peer = sys.argv[2] if len(sys.argv) > 2 else None
+    sys.exit(run(url, peer))
+
+if __name__ == '__main__':
+    main()
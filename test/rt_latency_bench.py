@@ -0,0 +1,98 @@
+"""
+Worst case read latency with and without `--realtime`. Single bytes are
+written to a pty that spcom reads, and the time until the byte shows up on
+spcom stdout (`--raw-out`) is measured, e.g.
+
+    python3 rt_latency_bench.py --spcom ../spcom/build/spcom --load 8
+
+`--load` starts busy processes, one per CPU by default, as on a loaded CI
+host. Both runs use the same load. Realtime priority requires CAP_SYS_NICE
+or RLIMIT_RTPRIO, e.g. `sudo` or `ulimit -r 50`, otherwise spcom warns and
+the runs are equal.
+
+The measurement includes the script itself, so compare runs, not absolute
+numbers.
+"""
+import argparse
+import os
+import select
+import shlex
+import signal
+import subprocess
+import sys
+import time
+
+from spcom_pty import SpcomPty
+
+
+def busy():
+    while True:
+        pass
+
+
+def measure(args, extra):
+    lat = []
+    with SpcomPty(args.spcom, ["--raw-out"] + shlex.split(extra),
+                  stdout=subprocess.PIPE) as pty:
+        out = pty.proc.stdout.fileno()
+        for i in range(args.count):
+            t0 = time.perf_counter()
+            os.write(pty.master, b"x")
+            r, _, _ = select.select([out], [], [], 1.0)
+            if not r:
+                print("timeout")
+                break
+            os.read(out, 1)
+            lat.append(time.perf_counter() - t0)
+            time.sleep(args.interval)
+
+    lat.sort()
+    return lat
+
+
+def report(name, lat):
+    if not lat:
+        print("%-10s no samples" % name)
+        return
+
+    def us(q):
+        return 1e6 * lat[min(len(lat) - 1, int(q * len(lat)))]
+
+    print("%-10s p50 %8.1f us  p99 %8.1f us  max %8.1f us" %
+          (name, us(0.5), us(0.99), 1e6 * lat[-1]))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--spcom", default="spcom")
+    parser.add_argument("--count", type=int, default=2000)
+    parser.add_argument("--interval", type=float, default=0.001,
+                        help="seconds between bytes")
+    parser.add_argument("--load", type=int, default=os.cpu_count(),
+                        help="busy processes. Default: %(default)s")
+    parser.add_argument("--prio", type=int, default=50)
+    parser.add_argument("--args", default="",
+                        help="other spcom options, used in both runs")
+    args = parser.parse_args()
+
+    load = []
+    for _ in range(args.load):
+        pid = os.fork()
+        if pid == 0:
+            busy()
+        load.append(pid)
+
+    try:
+        report("default", measure(args, args.args))
+        report("realtime", measure(args, "%s --realtime %d" % (args.args,
+                                                               args.prio)))
+    finally:
+        for pid in load:
+            os.kill(pid, signal.SIGKILL)
+            os.waitpid(pid, 0)
+
+    sys.exit(0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,58 @@
+"""
+pty fixture shared by the test and bench scripts. spcom is started on the
+slave end of a raw pty pair, the script writes to and reads from the master
+end, e.g.
+
+    with SpcomPty(args.spcom, ["--raw-out"], stdout=subprocess.PIPE) as p:
+        os.write(p.master, b"x")
+        p.proc.stdout.read(1)
+
+On exit spcom gets SIGINT, i.e. exits as on Ctrl-C, if still running, and the
+pty is closed.
+"""
+import os
+import signal
+import subprocess
+import time
+import tty
+
+# time for spcom to open the port
+STARTUP_WAIT = 1.0
+
+
+def open_pty():
+    """raw pty pair, i.e. no line discipline processing on either end"""
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    tty.setraw(master)
+    return master, slave
+
+
+class SpcomPty:
+    """spcom with options `args` on a new pty. Popen() takes `kwargs`"""
+
+    def __init__(self, spcom, args, **kwargs):
+        self.master, self.slave = open_pty()
+        self.path = os.ttyname(self.slave)
+
+        kwargs.setdefault("stdin", subprocess.PIPE)
+        self.proc = subprocess.Popen([spcom] + list(args) + [self.path],
+                                     **kwargs)
+        time.sleep(STARTUP_WAIT)
+
+    def interrupt(self):
+        """SIGINT, e.g. for the `--stats` summary. Caller waits"""
+        self.proc.send_signal(signal.SIGINT)
+
+    def close(self):
+        if self.proc.poll() is None:
+            self.interrupt()
+            self.proc.wait(timeout=5)
+        os.close(self.master)
+        os.close(self.slave)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()